@@ -0,0 +1,117 @@
+#include "Assets/AsyncIO.hh"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Bench.hh"
+
+//Throughput of CAsyncIO against its queue depth (number of workers) on a corpus of host files and the same files in a CVFS.
+//Usage: bench_asyncqueue [corpus dir], the default corpus is external/, run from the repo root.
+//Every row reads the corpus 3 times. "sync" reads it with std::ifstream on the calling thread, as the loaders did.
+
+using namespace Assets;
+namespace fs = std::filesystem;
+
+namespace
+{
+	constexpr unsigned PASSES = 3;
+
+	template<class F>
+	void Row(const char *Name, const std::vector<std::string> &Files, F &&Read)
+	{
+		size_t Bytes = 0;
+		double Ms = Bench::Best(3, [&] { Bytes = Read(); });
+		printf("%6s %12.0f %12.0f\n", Name, Bytes / 1e6 / (Ms / 1e3), PASSES * Files.size() / (Ms / 1e3));
+	}
+}
+
+int main(int argc, char **argv)
+{
+	fs::path Root = argc > 1 ? argv[1] : "external";
+
+	std::vector<std::string> HostFiles, VfsFiles;
+	CVFS Vfs;
+	size_t Total = 0;
+	for (auto &Entry : fs::recursive_directory_iterator(Root))
+	{
+		if(!Entry.is_regular_file())
+			continue;
+
+		std::string Rel = "/" + Entry.path().lexically_relative(Root).generic_string();
+		std::ifstream In(Entry.path(), std::ios::binary);
+		std::stringstream Data;
+		Data << In.rdbuf();
+
+		Vfs.CreateDir(Rel.substr(0, Rel.find_last_of('/') + 1), true);
+		Vfs.Open(Rel, FileMode::RW)->Write(Data.str());
+
+		HostFiles.push_back(Entry.path().string());
+		VfsFiles.push_back(Rel);
+		Total += Entry.file_size();
+	}
+
+	printf("corpus %s: %zu files, %.2f MB, page cache warm\n", Root.generic_string().c_str(), HostFiles.size(), Total / 1e6);
+
+	printf("\nhost files\n%6s %12s %12s\n", "QD", "MB/s", "files/s");
+	Row("sync", HostFiles, [&]
+	{
+		size_t Bytes = 0;
+		for (unsigned Pass = 0; Pass < PASSES; Pass++)
+		{
+			for (auto &Path : HostFiles)
+			{
+				std::ifstream In(Path, std::ios::binary);
+				std::stringstream Data;
+				Data << In.rdbuf();
+				Bytes += Data.str().size();
+			}
+		}
+
+		return Bytes;
+	});
+
+	for (unsigned Depth : {1, 2, 4, 8, 16, 32})
+	{
+		CAsyncIO IO(Depth);
+		Row(std::to_string(Depth).c_str(), HostFiles, [&]
+		{
+			std::vector<IORequest> Requests;
+			for (unsigned Pass = 0; Pass < PASSES; Pass++)
+			{
+				for (auto &Path : HostFiles)
+					Requests.push_back(IO.ReadAsync(Path));
+			}
+
+			size_t Bytes = 0;
+			for (auto &Request : Requests)
+				Bytes += Request->Get().Size();
+
+			return Bytes;
+		});
+	}
+
+	printf("\nCVFS files\n%6s %12s %12s\n", "QD", "MB/s", "files/s");
+	for (unsigned Depth : {1, 2, 4, 8, 16, 32})
+	{
+		CAsyncIO IO(Depth);
+		Row(std::to_string(Depth).c_str(), VfsFiles, [&]
+		{
+			std::vector<IORequest> Requests;
+			for (unsigned Pass = 0; Pass < PASSES; Pass++)
+			{
+				for (auto &Path : VfsFiles)
+					Requests.push_back(IO.ReadAsync(Vfs, Path));
+			}
+
+			size_t Bytes = 0;
+			for (auto &Request : Requests)
+				Bytes += Request->Get().Size();
+
+			return Bytes;
+		});
+	}
+
+	return 0;
+}
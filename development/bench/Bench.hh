@@ -0,0 +1,42 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+//Helpers shared by the benchmarks. They are plain programs printing their results, built with "ninja bench".
+namespace Bench
+{
+	using Clock = std::chrono::steady_clock;
+
+	inline double Milliseconds(Clock::time_point Start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - Start).count();
+	}
+
+	//Runs Func once and returns its duration in ms.
+	template<class F>
+	double Time(F &&Func)
+	{
+		auto Start = Clock::now();
+		Func();
+		return Milliseconds(Start);
+	}
+
+	//Best of Runs calls, which filters out scheduling noise for short measurements.
+	template<class F>
+	double Best(unsigned Runs, F &&Func)
+	{
+		double Ret = Time(Func);
+		for (unsigned i = 1; i < Runs; i++)
+			Ret = std::min(Ret, Time(Func));
+
+		return Ret;
+	}
+
+	//Keeps the compiler from dropping a computation whose result is unused.
+	template<class T>
+	inline void Use(const T &Value)
+	{
+		asm volatile("" : : "r,m"(Value) : "memory");
+	}
+}
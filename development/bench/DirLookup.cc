@@ -0,0 +1,168 @@
+#include "Assets/VFS.hh"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Bench.hh"
+
+//Directory insertion and lookup: the hash indexed CVFSDir against the former sorted vector with recursive binary search.
+//Usage: bench_dirlookup [--all]. Without --all the former insertion is skipped for 100k childs, it's O(n^2) and takes minutes.
+
+namespace
+{
+	//The former directory, reduced to what insertion and lookup did: every probe locked the child and copied its name.
+	class CSortedNode
+	{
+		public:
+			CSortedNode(const std::string &Name) : m_Name(Name) {}
+
+			std::string Name() const
+			{
+				std::lock_guard<std::mutex> lock(m_UpdateLock);
+				return m_Name;
+			}
+
+		private:
+			std::string m_Name;
+			mutable std::mutex m_UpdateLock;
+	};
+
+	class CSortedDir
+	{
+		public:
+			void AppendChild(std::shared_ptr<CSortedNode> Child)
+			{
+				std::lock_guard<std::mutex> lock(m_UpdateLock);
+				size_t Pos = 0;
+				for (Pos = 0; Pos < m_Childs.size(); Pos++)
+				{
+					if(Child->Name() < m_Childs[Pos]->Name())
+						break;
+				}
+
+				m_Childs.insert(m_Childs.begin() + Pos, Child);
+			}
+
+			//Fills an empty directory from childs already in name order, without the insertion scan.
+			void AssignSorted(std::vector<std::shared_ptr<CSortedNode>> Childs)
+			{
+				std::lock_guard<std::mutex> lock(m_UpdateLock);
+				m_Childs = std::move(Childs);
+			}
+
+			std::shared_ptr<CSortedNode> Search(const std::string &Name)
+			{
+				std::lock_guard<std::mutex> lock(m_UpdateLock);
+				if(m_Childs.empty())
+					return nullptr;
+
+				size_t Pos = Search(Name, 0, m_Childs.size() - 1);
+				return m_Childs[Pos]->Name() == Name ? m_Childs[Pos] : nullptr;
+			}
+
+		private:
+			size_t Search(const std::string &Name, size_t Start, size_t End)
+			{
+				if(End < Start || End == (size_t) -1)
+					return 0;
+				else if(End == Start)
+					return End;
+
+				size_t Middle = Start + (End - Start) / 2;
+				std::string PosName = m_Childs[Middle]->Name();
+				if(PosName == Name)
+					return Middle;
+				else if(Name > PosName)
+					return Search(Name, Middle + 1, End);
+				else if(Name < PosName)
+					return Search(Name, Start, Middle - 1);
+
+				return Middle;
+			}
+
+			std::vector<std::shared_ptr<CSortedNode>> m_Childs;
+			std::mutex m_UpdateLock;
+	};
+}
+
+int main(int argc, char **argv)
+{
+	bool All = argc > 1 && strcmp(argv[1], "--all") == 0;
+
+	printf("%8s  %-28s %12s %12s\n", "childs", "directory", "insert ms", "lookup ms");
+	for (size_t Count : {10000, 100000})
+	{
+		std::vector<std::string> Names;
+		for (size_t i = 0; i < Count; i++)
+			Names.push_back("node" + std::to_string(i * 7919 % Count));
+
+		//The CVFS side goes through the public API, so it also pays for path parsing and node creation.
+		{
+			Assets::CVFS Vfs;
+			Vfs.CreateDir("/b");
+			auto Dir = Vfs.GetNodeInfo("/b");
+
+			double Insert = Bench::Time([&]
+			{
+				for (auto &Name : Names)
+					Vfs.CreateDir("/b/" + Name);
+			});
+
+			size_t Found = 0;
+			double Lookup = Bench::Best(3, [&]
+			{
+				Found = 0;
+				for (auto &Name : Names)
+					Found += Vfs.GetNodeInfoAt(Dir, Name) != nullptr;
+			});
+
+			printf("%8zu  %-28s %12.1f %12.1f%s\n", Count, "hash index (CVFS)", Insert, Lookup, Found == Count ? "" : "  MISSING NODES");
+		}
+
+		{
+			CSortedDir Dir;
+			double Insert = -1;
+			if(Count <= 10000 || All)
+			{
+				Insert = Bench::Time([&]
+				{
+					for (auto &Name : Names)
+					{
+						if(!Dir.Search(Name))
+							Dir.AppendChild(std::make_shared<CSortedNode>(Name));
+					}
+				});
+			}
+			else
+			{
+				//Same contents without the quadratic insertion, so the lookup can still be measured.
+				std::vector<std::string> Sorted = Names;
+				std::sort(Sorted.begin(), Sorted.end());
+
+				std::vector<std::shared_ptr<CSortedNode>> Childs;
+				for (auto &Name : Sorted)
+					Childs.push_back(std::make_shared<CSortedNode>(Name));
+
+				Dir.AssignSorted(std::move(Childs));
+			}
+
+			size_t Found = 0;
+			double Lookup = Bench::Best(3, [&]
+			{
+				Found = 0;
+				for (auto &Name : Names)
+					Found += Dir.Search(Name) != nullptr;
+			});
+
+			if(Insert < 0)
+				printf("%8zu  %-28s %12s %12.1f\n", Count, "sorted vector (former)", "(--all)", Lookup);
+			else
+				printf("%8zu  %-28s %12.1f %12.1f%s\n", Count, "sorted vector (former)", Insert, Lookup, Found == Count ? "" : "  MISSING NODES");
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,84 @@
+#include "Assets/VFS.hh"
+#include <random>
+#include <string>
+#include <string_view>
+
+#include "Bench.hh"
+
+//Line reading throughput of CVFSFileStream on an in-memory CSV file.
+//Usage: bench_linereader [MB], the default is 50 MB.
+//"former ReadLine" is the reader before buffering: one Read call per byte, appended to a string.
+
+using namespace Assets;
+
+int main(int argc, char **argv)
+{
+	size_t Size = size_t(argc > 1 ? std::stod(argv[1]) : 50) * 1000 * 1000;
+
+	std::mt19937 Random(10);
+	std::string Csv;
+	while (Csv.size() < Size)
+		Csv += std::to_string(Random()) + "," + std::to_string(Random() % 1000) + ",some text field," + std::to_string(Random() % 7) + "\n";
+
+	CVFS Vfs;
+	Vfs.Open("/data.csv", FileMode::RW)->Write(Csv);
+
+	auto Report = [&](const char *Name, double Ms, size_t Lines)
+	{
+		printf("%-28s %10.1f ms %8.0f MB/s %10zu lines\n", Name, Ms, Csv.size() / 1e6 / (Ms / 1e3), Lines);
+	};
+
+	size_t Lines = 0, Bytes = 0;
+	double Ms = Bench::Time([&]
+	{
+		auto File = Vfs.Open("/data.csv", FileMode::READ);
+		while (!File->IsEOF())
+		{
+			std::string Line;
+			char c;
+			while (File->Read(&c, sizeof(c)) != 0)
+			{
+				if(c == '\n')
+					break;
+
+				Line += c;
+			}
+
+			Bytes += Line.size();
+			Lines++;
+		}
+	});
+	Report("former ReadLine()", Ms, Lines);
+
+	Ms = Bench::Best(3, [&]
+	{
+		auto File = Vfs.Open("/data.csv", FileMode::READ);
+		for (Lines = 0; !File->IsEOF(); Lines++)
+			Bytes += File->ReadLine().size();
+	});
+	Report("ReadLine()", Ms, Lines);
+
+	Ms = Bench::Best(3, [&]
+	{
+		auto File = Vfs.Open("/data.csv", FileMode::READ);
+		std::string_view Line;
+		for (Lines = 0; File->ReadLine(Line); Lines++)
+			Bytes += Line.size();
+	});
+	Report("ReadLine(std::string_view&)", Ms, Lines);
+
+	Ms = Bench::Best(3, [&]
+	{
+		auto File = Vfs.Open("/data.csv", FileMode::READ);
+		Lines = 0;
+		for (std::string_view Line : File->Lines())
+		{
+			Bytes += Line.size();
+			Lines++;
+		}
+	});
+	Report("Lines()", Ms, Lines);
+
+	Bench::Use(Bytes);
+	return 0;
+}
@@ -0,0 +1,89 @@
+#include "Audio/Mixer.hh"
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Bench.hh"
+
+//Mixing cost of one output period: 64 stereo voices of 480 frames (10 ms at 48 kHz) summed into the output buffer.
+//Usage: bench_mixer [voices], the default is 64.
+//"former loop" is the per-sample mix before the kernels: out[i] += vol * in[i] with one gain for both channels.
+
+using namespace Audio;
+
+namespace
+{
+	constexpr size_t FRAMES = 480;
+	constexpr unsigned PERIODS = 2000;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned Voices = argc > 1 ? std::stoul(argv[1]) : 64;
+
+	std::mt19937 Random(22);
+	std::uniform_real_distribution<float> Uniform(-1.0f, 1.0f);
+
+	std::vector<float> Out(FRAMES * 2);
+	std::vector<std::vector<float>> Sources(Voices, std::vector<float>(FRAMES * 2));
+	std::vector<Mixer::Gains> Gains(Voices);
+	std::vector<float> Volumes(Voices);
+	for (unsigned v = 0; v < Voices; v++)
+	{
+		for (auto &Sample : Sources[v])
+			Sample = Uniform(Random) * 0.1f;
+
+		Volumes[v] = 0.5f;
+		Gains[v] = Mixer::Pan(Volumes[v], Uniform(Random));
+	}
+
+	auto Report = [&](const char *Name, double Ms)
+	{
+		printf("%-24s %10.1f ms %10.0f voices/ms %8.2f us/period\n", Name, Ms, PERIODS * Voices / Ms, Ms * 1e3 / PERIODS);
+	};
+
+	printf("%u voices x %zu stereo frames, %u periods\n\n", Voices, FRAMES, PERIODS);
+
+	Report("former loop", Bench::Best(3, [&]
+	{
+		for (unsigned p = 0; p < PERIODS; p++)
+		{
+			std::fill(Out.begin(), Out.end(), 0.0f);
+			for (unsigned v = 0; v < Voices; v++)
+			{
+				const float *In = Sources[v].data();
+				for (size_t i = 0; i < Out.size(); i++)
+					Out[i] += Volumes[v] * In[i];
+			}
+
+			Bench::Use(Out[3]);
+		}
+	}));
+
+	Report("Accumulate", Bench::Best(3, [&]
+	{
+		for (unsigned p = 0; p < PERIODS; p++)
+		{
+			std::fill(Out.begin(), Out.end(), 0.0f);
+			for (unsigned v = 0; v < Voices; v++)
+				Mixer::Accumulate(Out.data(), Sources[v].data(), Out.size(), Gains[v]);
+
+			Bench::Use(Out[3]);
+		}
+	}));
+
+	Report("Accumulate, MasterLimit", Bench::Best(3, [&]
+	{
+		for (unsigned p = 0; p < PERIODS; p++)
+		{
+			std::fill(Out.begin(), Out.end(), 0.0f);
+			for (unsigned v = 0; v < Voices; v++)
+				Mixer::Accumulate(Out.data(), Sources[v].data(), Out.size(), Gains[v]);
+
+			Mixer::MasterLimit(Out.data(), Out.size(), 0.8f, 0.8f);
+			Bench::Use(Out[3]);
+		}
+	}));
+
+	return 0;
+}
@@ -0,0 +1,104 @@
+#include "Assets/VFS.hh"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "Bench.hh"
+
+//Size and load time of the "CVFS-DISK" image against the block compressed "CVFS-PACK" image.
+//Usage: bench_packedimage [corpus dir], the default corpus is external/ (sources and headers), run from the repo root.
+//The page cache is warm, so the load times show decoding cost, not disk I/O.
+
+using namespace Assets;
+namespace fs = std::filesystem;
+
+namespace
+{
+	struct SCorpus
+	{
+		std::vector<std::string> Files;	//VFS paths
+		size_t Bytes = 0;
+	};
+
+	SCorpus LoadCorpus(CVFS &Vfs, const fs::path &Root)
+	{
+		SCorpus Ret;
+		for (auto &Entry : fs::recursive_directory_iterator(Root))
+		{
+			std::string Rel = "/" + Entry.path().lexically_relative(Root).generic_string();
+			if(Entry.is_directory())
+				Vfs.CreateDir(Rel, true);
+			else if(Entry.is_regular_file())
+			{
+				std::ifstream In(Entry.path(), std::ios::binary);
+				std::stringstream Data;
+				Data << In.rdbuf();
+
+				Vfs.Open(Rel, FileMode::RW)->Write(Data.str());
+				Ret.Files.push_back(Rel);
+				Ret.Bytes += Data.str().size();
+			}
+		}
+
+		return Ret;
+	}
+
+	//Mounts the image and reads every file, returns the bytes read.
+	size_t ReadAll(const std::string &Image, const SCorpus &Corpus, bool Mount)
+	{
+		CVFS Vfs;
+		if(Mount)
+			Vfs.MountImage(Image);
+		else
+		{
+			std::ifstream In(Image, std::ios::binary);
+			std::vector<char> Data((std::istreambuf_iterator<char>(In)), std::istreambuf_iterator<char>());
+			Vfs.Deserialize(Data);
+		}
+
+		std::vector<char> Buf(1 << 20);
+		size_t Ret = 0;
+		for (auto &Path : Corpus.Files)
+		{
+			auto File = Vfs.Open(Path, FileMode::READ);
+			while (size_t Readed = File->Read(Buf.data(), Buf.size()))
+				Ret += Readed;
+		}
+
+		return Ret;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	fs::path Root = argc > 1 ? argv[1] : "external";
+	CVFS Vfs;
+	SCorpus Corpus = LoadCorpus(Vfs, Root);
+	printf("corpus %s: %zu files, %.2f MB\n\n", Root.generic_string().c_str(), Corpus.Files.size(), Corpus.Bytes / 1e6);
+
+	fs::path Tmp = fs::temp_directory_path();
+	std::string Disk = (Tmp / "bench_packedimage.cvfs").string();
+	std::string Pack = (Tmp / "bench_packedimage.pak").string();
+
+	double DiskWrite = Bench::Best(3, [&] { std::ofstream Out(Disk, std::ios::binary); Vfs.Serialize(Out); });
+	double PackWrite = Bench::Best(3, [&] { std::ofstream Out(Pack, std::ios::binary); Vfs.Pack(Out); });
+
+	printf("%-16s %10s %8s %10s %14s %20s\n", "format", "MB", "ratio", "write ms", "mount+read ms", "deserialize+read ms");
+	for (auto [Name, Path, Write] : {std::make_tuple("CVFS-DISK (v1)", Disk, DiskWrite), std::make_tuple("CVFS-PACK (v2)", Pack, PackWrite)})
+	{
+		size_t Readed = 0;
+		double Mount = Bench::Best(5, [&] { Readed = ReadAll(Path, Corpus, true); });
+		double Load = Bench::Best(5, [&] { Readed = ReadAll(Path, Corpus, false); });
+
+		double Size = double(fs::file_size(Path));
+		printf("%-16s %10.2f %7.2fx %10.1f %14.1f %20.1f%s\n", Name, Size / 1e6, Corpus.Bytes / Size, Write, Mount, Load,
+			Readed == Corpus.Bytes ? "" : "  SIZE MISMATCH");
+	}
+
+	fs::remove(Disk);
+	fs::remove(Pack);
+	return 0;
+}
@@ -0,0 +1,72 @@
+#include "Assets/VFS.hh"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Bench.hh"
+
+//N threads stream the same hot file concurrently, in 16 KiB reads through their own streams.
+//Usage: bench_readthroughput [file MiB] [max threads], the defaults are 64 MiB and 16 threads.
+//Each row reads the file 64 times in total, split across the threads. Scaling needs as many cores as threads.
+
+using namespace Assets;
+
+namespace
+{
+	constexpr size_t READ_SIZE = 16 * 1024;
+	constexpr unsigned PASSES = 64;
+
+	double Throughput(CVFS &Vfs, unsigned Threads)
+	{
+		std::atomic<size_t> Total{0};
+		double Ms = Bench::Time([&]
+		{
+			std::vector<std::thread> Readers;
+			for (unsigned t = 0; t < Threads; t++)
+			{
+				Readers.emplace_back([&, t]
+				{
+					std::vector<char> Buf(READ_SIZE);
+					size_t Readed = 0;
+					for (unsigned Pass = t; Pass < PASSES; Pass += Threads)
+					{
+						auto File = Vfs.Open("/hot", FileMode::READ);
+						while (size_t Count = File->Read(Buf.data(), Buf.size()))
+							Readed += Count;
+					}
+
+					Total += Readed;
+				});
+			}
+
+			for (auto &Reader : Readers)
+				Reader.join();
+		});
+
+		return Total / 1e6 / (Ms / 1e3);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	size_t Size = (argc > 1 ? std::stoul(argv[1]) : 64) << 20;
+	unsigned MaxThreads = argc > 2 ? std::stoul(argv[2]) : 16;
+
+	std::string Data(Size, '\0');
+	for (size_t i = 0; i < Size; i++)
+		Data[i] = char(i * 7);
+
+	SVFSOptions NoAtime;
+	NoAtime.NoAtime = true;
+	CVFS Vfs, VfsNoAtime(NoAtime);
+	Vfs.Open("/hot", FileMode::RW)->Write(Data);
+	VfsNoAtime.Open("/hot", FileMode::RW)->Write(Data);
+
+	printf("%u MiB file, %u hardware threads\n\n", unsigned(Size >> 20), std::thread::hardware_concurrency());
+	printf("%8s %14s %20s\n", "threads", "MB/s", "MB/s (NoAtime)");
+	for (unsigned Threads = 1; Threads <= MaxThreads; Threads *= 2)
+		printf("%8u %14.0f %20.0f\n", Threads, Throughput(Vfs, Threads), Throughput(VfsNoAtime, Threads));
+
+	return 0;
+}
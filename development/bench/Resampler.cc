@@ -0,0 +1,105 @@
+#include "Audio/Resampler.hh"
+#include <miniaudio.h>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "Bench.hh"
+
+//Cost of the voice resampler against the linear resampler of miniaudio, which the decoders used before.
+//Usage: bench_resampler [sound file], the default is resources/test.mp3, run from the repo root.
+//"per voice" is one 10 ms period at 48 kHz of the decoded file, including the decoding.
+
+using namespace Audio;
+
+namespace
+{
+	constexpr unsigned DEVICE_RATE = 48000;
+	constexpr unsigned PERIOD = DEVICE_RATE / 100;
+	constexpr unsigned PERIODS = 300;
+
+	std::vector<float> Tone(size_t Frames, unsigned Rate)
+	{
+		std::vector<float> Ret(Frames * 2);
+		for (size_t i = 0; i < Frames; i++)
+			Ret[i * 2] = Ret[i * 2 + 1] = float(0.5 * std::sin(2 * 3.14159265358979323846 * 1000 * i / Rate));
+
+		return Ret;
+	}
+
+	std::vector<float> Linear(const std::vector<float> &In, unsigned From, unsigned To)
+	{
+		auto Config = ma_resampler_config_init(ma_format_f32, 2, From, To, ma_resample_algorithm_linear);
+		ma_resampler Resampler;
+		ma_resampler_init(&Config, &Resampler);
+
+		ma_uint64 InFrames = In.size() / 2, OutFrames = ma_uint64(double(InFrames) * To / From);
+		std::vector<float> Ret(OutFrames * 2);
+		ma_resampler_process_pcm_frames(&Resampler, In.data(), &InFrames, Ret.data(), &OutFrames);
+		ma_resampler_uninit(&Resampler);
+
+		Ret.resize(OutFrames * 2);
+		return Ret;
+	}
+
+	bool Open(ma_decoder &Decoder, const std::string &Path, unsigned Rate)
+	{
+		ma_decoder_config Config = ma_decoder_config_init(ma_format_f32, 2, Rate);
+		return ma_decoder_init_file(Path.c_str(), &Config, &Decoder) == MA_SUCCESS;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	std::string Path = argc > 1 ? argv[1] : "resources/test.mp3";
+	Resampler::Init();
+
+	printf("%-36s %14s %14s\n", "", "ours", "ma linear");
+
+	auto In = Tone(441000, 44100);
+	size_t Frames = 0;
+	double Ours = Bench::Best(3, [&] { Frames = Resampler::Convert(In.data(), In.size() / 2, 44100, DEVICE_RATE).size() / 2; });
+	double Theirs = Bench::Best(3, [&] { Frames = Linear(In, 44100, DEVICE_RATE).size() / 2; });
+	printf("%-36s %9.1f Mf/s %9.1f Mf/s\n", "44.1 -> 48 kHz, 10 s of stereo", Frames / Ours / 1e3, Frames / Theirs / 1e3);
+
+	ma_decoder Native, Converting;
+	if(!Open(Native, Path, 0) || !Open(Converting, Path, DEVICE_RATE))
+	{
+		printf("can't decode %s\n", Path.c_str());
+		return 1;
+	}
+
+	//Both decode the same periods, seeking back to the start before each run.
+	std::vector<float> Out(PERIOD * 2), Scratch(Resampler::scratchSamples);
+	const double Step = double(Native.outputSampleRate) / DEVICE_RATE;
+	Ours = Bench::Best(3, [&]
+	{
+		ma_decoder_seek_to_pcm_frame(&Native, 0);
+		Resampler::State State;
+		for (unsigned p = 0; p < PERIODS; p++)
+		{
+			Resampler::Process(State, Out.data(), PERIOD, Step, Scratch.data(), [&](float *Dst, size_t Count)
+			{
+				return size_t(ma_decoder_read_pcm_frames(&Native, Dst, Count));
+			});
+			Bench::Use(Out[0]);
+		}
+	});
+
+	Theirs = Bench::Best(3, [&]
+	{
+		ma_decoder_seek_to_pcm_frame(&Converting, 0);
+		for (unsigned p = 0; p < PERIODS; p++)
+		{
+			ma_decoder_read_pcm_frames(&Converting, Out.data(), PERIOD);
+			Bench::Use(Out[0]);
+		}
+	});
+
+	std::string Name = "per voice, " + std::to_string(Native.outputSampleRate) + " Hz source";
+	printf("%-36s %9.1f us   %9.1f us\n", Name.c_str(), Ours * 1e3 / PERIODS, Theirs * 1e3 / PERIODS);
+
+	ma_decoder_uninit(&Native);
+	ma_decoder_uninit(&Converting);
+	return 0;
+}
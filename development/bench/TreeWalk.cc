@@ -0,0 +1,97 @@
+#include "Assets/NodeTable.hh"
+#include <string>
+
+#include "Bench.hh"
+
+//Recursive walk over a tree of about 1M nodes: List() of the shared_ptr tree, CVFS::Walk() and the flat CVFSNodeTable.
+//The table is a snapshot, which is built again after changes, so it's measured with and without building it.
+//Usage: bench_treewalk [dirs], the tree has dirs x dirs directories with 98 files each, the default 100 gives 990101 nodes.
+
+using namespace Assets;
+
+namespace
+{
+	size_t WalkList(CVFS &Vfs, const VFSNode &Dir, size_t &NameBytes)
+	{
+		size_t Ret = 1;
+		for (auto &Node : Vfs.List(Dir))
+		{
+			NameBytes += Node->Name().size();
+			Ret += Node->IsDir() ? WalkList(Vfs, Node, NameBytes) : 1;
+		}
+
+		return Ret;
+	}
+
+	size_t WalkTable(const CVFSNodeTable &Table, SNodeHandle Dir, size_t &NameBytes)
+	{
+		size_t Ret = 1;
+		for (auto Node : Table.Childs(Dir))
+		{
+			NameBytes += Table.Name(Node).size();
+			Ret += Table.IsDir(Node) ? WalkTable(Table, Node, NameBytes) : 1;
+		}
+
+		return Ret;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int Dirs = argc > 1 ? std::stoi(argv[1]) : 100;
+
+	SVFSOptions Options;
+	Options.NoAtime = true;
+	CVFS Vfs(Options);
+	for (int i = 0; i < Dirs; i++)
+	{
+		for (int j = 0; j < Dirs; j++)
+		{
+			std::string Dir = "/d" + std::to_string(i) + "/e" + std::to_string(j);
+			Vfs.CreateDir(Dir, true);
+			for (int k = 0; k < 98; k++)
+				Vfs.Open(Dir + "/f" + std::to_string(k), FileMode::RW);
+		}
+	}
+
+	size_t Nodes = 0, NameBytes = 0;
+	auto Report = [&](const char *Name, double Ms)
+	{
+		printf("%-28s %10.1f ms %10zu nodes %12zu name bytes\n", Name, Ms, Nodes, NameBytes);
+	};
+
+	Report("CVFS List()", Bench::Best(3, [&]
+	{
+		NameBytes = 0;
+		Nodes = WalkList(Vfs, Vfs.GetNodeInfo("/"), NameBytes);
+	}));
+
+	Report("CVFS Walk()", Bench::Best(3, [&]
+	{
+		Nodes = 1;
+		NameBytes = 0;
+		Vfs.Walk("/", [&](std::span<const SVFSEntry> Entries)
+		{
+			for (auto &Entry : Entries)
+				NameBytes += Entry.Name().size();
+
+			Nodes += Entries.size();
+		});
+	}));
+
+	Report("CVFSNodeTable, build + walk", Bench::Best(3, [&]
+	{
+		CVFSNodeTable Table(Vfs);
+		NameBytes = 0;
+		Nodes = WalkTable(Table, Table.Root(), NameBytes);
+	}));
+
+	CVFSNodeTable Table(Vfs);
+	Report("CVFSNodeTable, walk", Bench::Best(3, [&]
+	{
+		NameBytes = 0;
+		Nodes = WalkTable(Table, Table.Root(), NameBytes);
+	}));
+
+	return 0;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdio>
+#include <exception>
+
+//Minimal checking for the tests. They are plain programs built with "ninja tests", a failed check is printed and the
+//program exits with 1.
+namespace Check
+{
+	inline int Failures = 0;
+
+	inline bool Report(bool Ok, const char *Expr, const char *File, int Line)
+	{
+		if(!Ok)
+		{
+			printf("%s:%d: check failed: %s\n", File, Line, Expr);
+			Failures++;
+		}
+
+		return Ok;
+	}
+
+	//Runs one test case, an exception escaping it counts as failure.
+	template<class F>
+	void Case(const char *Name, F &&Func)
+	{
+		int Before = Failures;
+		try
+		{
+			Func();
+		}
+		catch(const std::exception &e)
+		{
+			printf("%s: unexpected exception: %s\n", Name, e.what());
+			Failures++;
+		}
+
+		printf("%-48s %s\n", Name, Failures == Before ? "ok" : "FAILED");
+	}
+
+	inline int Result()
+	{
+		return Failures ? 1 : 0;
+	}
+}
+
+#define CHECK(Expr) Check::Report(static_cast<bool>(Expr), #Expr, __FILE__, __LINE__)
@@ -0,0 +1,174 @@
+#include "Assets/VFS.hh"
+#include <string>
+
+#include "Check.hh"
+
+//CVFS::Copy shares the chunks of files copy-on-write. Changes on either side must stay invisible to the other.
+
+using namespace Assets;
+
+namespace
+{
+	std::string Pattern(size_t Size, char Seed)
+	{
+		std::string Ret(Size, '\0');
+		for (size_t i = 0; i < Size; i++)
+			Ret[i] = char(Seed + i * 31 % 97);
+
+		return Ret;
+	}
+
+	std::string ReadAll(CVFS &Vfs, const std::string &Path)
+	{
+		return Vfs.Open(Path, FileMode::READ)->Read();
+	}
+
+	void Append(CVFS &Vfs, const std::string &Path, const std::string &Data)
+	{
+		Vfs.Open(Path, FileMode::RW | FileMode::APPEND)->Write(Data);
+	}
+
+	//A template dir with a file of several chunks, whose last chunk is partially filled, and an inline file.
+	const std::string Big = Pattern(CHUNK_SIZE * 3 + 1000, 'a');
+	const std::string Small = "small file";
+
+	void MakeTemplate(CVFS &Vfs)
+	{
+		Vfs.CreateDir("/tpl/sub", true);
+		Vfs.Open("/tpl/sub/big", FileMode::RW)->Write(Big);
+		Vfs.Open("/tpl/small", FileMode::RW)->Write(Small);
+	}
+}
+
+int main()
+{
+	Check::Case("copy shares the chunks", []
+	{
+		CVFS Vfs;
+		MakeTemplate(Vfs);
+		size_t Before = Vfs.Stats().ChunkMemory;
+
+		Vfs.Copy("/tpl", "/copy");
+		CHECK(Vfs.Stats().ChunkMemory == Before);
+		CHECK(ReadAll(Vfs, "/copy/sub/big") == Big);
+		CHECK(ReadAll(Vfs, "/copy/small") == Small);
+	});
+
+	Check::Case("append to a copy privatizes only the last chunk", []
+	{
+		CVFS Vfs;
+		MakeTemplate(Vfs);
+		Vfs.Copy("/tpl", "/copy");
+		size_t Before = Vfs.Stats().ChunkMemory;
+
+		Append(Vfs, "/copy/sub/big", "tail");
+		CHECK(Vfs.Stats().ChunkMemory == Before + CHUNK_SIZE);
+		CHECK(ReadAll(Vfs, "/copy/sub/big") == Big + "tail");
+		CHECK(ReadAll(Vfs, "/tpl/sub/big") == Big);
+	});
+
+	Check::Case("copies of one template stay apart", []
+	{
+		CVFS Vfs;
+		MakeTemplate(Vfs);
+		Vfs.CreateDir("/slots");
+		Vfs.Copy("/tpl", "/slots/s1");
+		Vfs.Copy("/tpl", "/slots/s2");
+
+		std::string Grow = Pattern(CHUNK_SIZE * 2, 'x');   //Spills into new chunks.
+		Append(Vfs, "/slots/s1/sub/big", Grow);
+		Append(Vfs, "/slots/s2/sub/big", "ZZ");
+		Append(Vfs, "/slots/s2/small", "!");
+
+		CHECK(ReadAll(Vfs, "/tpl/sub/big") == Big);
+		CHECK(ReadAll(Vfs, "/slots/s1/sub/big") == Big + Grow);
+		CHECK(ReadAll(Vfs, "/slots/s2/sub/big") == Big + "ZZ");
+		CHECK(ReadAll(Vfs, "/tpl/small") == Small);
+		CHECK(ReadAll(Vfs, "/slots/s1/small") == Small);
+		CHECK(ReadAll(Vfs, "/slots/s2/small") == Small + "!");
+	});
+
+	Check::Case("writes to the original stay out of the copy", []
+	{
+		CVFS Vfs;
+		MakeTemplate(Vfs);
+		Vfs.Copy("/tpl", "/copy");
+
+		Append(Vfs, "/tpl/sub/big", "orig");
+		Append(Vfs, "/tpl/small", "orig");
+		CHECK(ReadAll(Vfs, "/tpl/sub/big") == Big + "orig");
+		CHECK(ReadAll(Vfs, "/copy/sub/big") == Big);
+		CHECK(ReadAll(Vfs, "/copy/small") == Small);
+	});
+
+	Check::Case("truncating a copy keeps the original", []
+	{
+		CVFS Vfs;
+		MakeTemplate(Vfs);
+		Vfs.Copy("/tpl", "/copy");
+
+		Vfs.Open("/copy/sub/big", FileMode::RW)->Write("new");
+		CHECK(ReadAll(Vfs, "/copy/sub/big") == "new");
+		CHECK(ReadAll(Vfs, "/tpl/sub/big") == Big);
+
+		Vfs.Open("/tpl/small", FileMode::WRITE)->Write("x");
+		CHECK(ReadAll(Vfs, "/copy/small") == Small);
+	});
+
+	Check::Case("tree changes in a copy stay in the copy", []
+	{
+		CVFS Vfs;
+		MakeTemplate(Vfs);
+		Vfs.Copy("/tpl", "/copy");
+
+		Vfs.Delete("/copy/sub/big");
+		Vfs.Open("/copy/sub/added", FileMode::RW)->Write("added");
+		Vfs.Rename("/copy/small", "renamed");
+
+		CHECK(Vfs.NodeExists("/tpl/sub/big"));
+		CHECK(!Vfs.NodeExists("/tpl/sub/added"));
+		CHECK(Vfs.NodeExists("/tpl/small"));
+		CHECK(ReadAll(Vfs, "/copy/renamed") == Small);
+	});
+
+	Check::Case("copy of a copy", []
+	{
+		CVFS Vfs;
+		MakeTemplate(Vfs);
+		Vfs.Copy("/tpl", "/a");
+		Vfs.Copy("/a", "/b");
+
+		Append(Vfs, "/a/sub/big", "A");
+		Append(Vfs, "/b/sub/big", "B");
+		CHECK(ReadAll(Vfs, "/tpl/sub/big") == Big);
+		CHECK(ReadAll(Vfs, "/a/sub/big") == Big + "A");
+		CHECK(ReadAll(Vfs, "/b/sub/big") == Big + "B");
+	});
+
+	Check::Case("views keep the content they were taken with", []
+	{
+		CVFS Vfs;
+		MakeTemplate(Vfs);
+		auto View = Vfs.Open("/tpl/sub/big", FileMode::READ)->ReadView();
+
+		Append(Vfs, "/tpl/sub/big", "more");
+		Vfs.Open("/tpl/sub/big", FileMode::WRITE)->Write("gone");
+
+		auto Data = View.Contiguous();
+		CHECK(std::string(Data.data(), Data.size()) == Big);
+	});
+
+	Check::Case("dropping copies frees their private chunks", []
+	{
+		CVFS Vfs;
+		MakeTemplate(Vfs);
+		size_t Before = Vfs.Stats().ChunkMemory;
+
+		Vfs.Copy("/tpl", "/copy");
+		Append(Vfs, "/copy/sub/big", Pattern(CHUNK_SIZE * 4, 'q'));
+		Vfs.Delete("/copy");
+		CHECK(Vfs.Stats().ChunkMemory == Before);
+	});
+
+	return Check::Result();
+}
@@ -0,0 +1,156 @@
+#include <miniaudio.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+//The test drives the device callback itself, so it needs the stream's internals.
+#define private public
+#include "Audio/Audio.hh"
+#undef private
+
+#include "Check.hh"
+
+//Decoded voices are stereo, the mix maps them onto the device's layout: mono gets (L + R) / 2, wider layouts get
+//L and R on the front pair and silence on the other channels. Checked on the sample values of a known stereo signal.
+
+namespace
+{
+	constexpr double PI = 3.14159265358979323846;
+	constexpr unsigned DEVICE_RATE = 48000;
+	constexpr unsigned PERIOD = 480;
+	constexpr unsigned FRAMES = 9600;
+
+	//16 bit stereo WAV with a 1 kHz sine on the left and a 500 Hz cosine on the right.
+	std::vector<char> Wav(unsigned Rate)
+	{
+		std::vector<char> Ret(44 + FRAMES * 4);
+		auto Put32 = [&](size_t Offset, uint32_t Value) { memcpy(&Ret[Offset], &Value, 4); };
+		auto Put16 = [&](size_t Offset, uint16_t Value) { memcpy(&Ret[Offset], &Value, 2); };
+		memcpy(&Ret[0], "RIFF", 4);
+		Put32(4, uint32_t(Ret.size() - 8));
+		memcpy(&Ret[8], "WAVEfmt ", 8);
+		Put32(16, 16);
+		Put16(20, 1);
+		Put16(22, 2);
+		Put32(24, Rate);
+		Put32(28, Rate * 4);
+		Put16(32, 4);
+		Put16(34, 16);
+		memcpy(&Ret[36], "data", 4);
+		Put32(40, FRAMES * 4);
+		for (unsigned i = 0; i < FRAMES; i++)
+		{
+			int16_t Left = int16_t(std::lround(0.4 * 32767 * std::sin(2 * PI * 1000 * i / Rate)));
+			int16_t Right = int16_t(std::lround(0.2 * 32767 * std::cos(2 * PI * 500 * i / Rate)));
+			memcpy(&Ret[44 + i * 4], &Left, 2);
+			memcpy(&Ret[46 + i * 4], &Right, 2);
+		}
+
+		return Ret;
+	}
+
+	//The exact input signal of the WAV, without quantization.
+	float Left(double Time)
+	{
+		return float(0.4 * std::sin(2 * PI * 1000 * Time));
+	}
+
+	float Right(double Time)
+	{
+		return float(0.2 * std::cos(2 * PI * 500 * Time));
+	}
+
+	//A stream without a running device: the test mixes the periods itself.
+	std::unique_ptr<Audio::SndOutStream> Offline(unsigned short Channels)
+	{
+		Audio::SndOutStreamConfig Config;
+		Config.sampleRate = DEVICE_RATE;
+		Config.channels = Channels;
+		Config.bufSizeMS = 10;
+		Config.limiterThreshold = 1.0f;
+		auto Ret = std::make_unique<Audio::SndOutStream>(Config);
+		if(Ret->initialized)
+			ma_device_uninit(&Ret->dev);
+
+		Ret->initialized = false;
+		Ret->rate = DEVICE_RATE;
+		return Ret;
+	}
+
+	//Plays the WAV at the given rate and returns the first Periods periods of the mix.
+	std::vector<float> Mix(unsigned short Channels, unsigned Rate, unsigned Periods, float Pan = 0.0f)
+	{
+		auto Stream = Offline(Channels);
+		auto Data = Wav(Rate);
+		Audio::AudioMemView Voice(Data.data(), Data.size());
+		Voice.SetPan(Pan);
+		Stream->Play(Voice);
+
+		std::vector<float> Ret(size_t(PERIOD) * Periods * Channels);
+		for (unsigned p = 0; p < Periods; p++)
+			Stream->DataCallbackImpl(Ret.data() + size_t(PERIOD) * p * Channels, PERIOD);
+
+		Stream->StopAll();
+		Stream->Update();
+		return Ret;
+	}
+
+	//Largest difference of a channel to the expected signal, from frame Begin on.
+	template<class F>
+	float Error(const std::vector<float> &Out, unsigned Channels, unsigned Channel, size_t Begin, F &&Expected)
+	{
+		float Ret = 0;
+		for (size_t i = Begin; i < Out.size() / Channels; i++)
+			Ret = std::max(Ret, std::fabs(Out[i * Channels + Channel] - Expected(double(i) / DEVICE_RATE)));
+
+		return Ret;
+	}
+}
+
+int main()
+{
+	//16 bit quantization leaves errors of about 3e-5.
+	constexpr float EXACT = 1e-4f;
+
+	Check::Case("stereo voice on a mono device", []
+	{
+		auto Out = Mix(1, DEVICE_RATE, 10);
+		CHECK(Error(Out, 1, 0, 0, [](double t) { return (Left(t) + Right(t)) / 2; }) < EXACT);
+	});
+
+	Check::Case("stereo voice on a 6 channel device", []
+	{
+		auto Out = Mix(6, DEVICE_RATE, 10);
+		CHECK(Error(Out, 6, 0, 0, Left) < EXACT);
+		CHECK(Error(Out, 6, 1, 0, Right) < EXACT);
+		for (unsigned c = 2; c < 6; c++)
+			CHECK(Error(Out, 6, c, 0, [](double) { return 0.0f; }) == 0);
+	});
+
+	Check::Case("panning on the front pair of a 6 channel device", []
+	{
+		auto Out = Mix(6, DEVICE_RATE, 10, -1.0f);
+		CHECK(Error(Out, 6, 0, 0, [](double t) { return Left(t) * std::sqrt(2.0f); }) < EXACT);
+		CHECK(Error(Out, 6, 1, 0, [](double) { return 0.0f; }) < EXACT);
+	});
+
+	//The resampler needs its window filled before the output settles, the first period is skipped.
+	Check::Case("resampled voice on a mono device", []
+	{
+		auto Out = Mix(1, 24000, 10);
+		CHECK(Error(Out, 1, 0, PERIOD, [](double t) { return (Left(t) + Right(t)) / 2; }) < 1e-3f);
+	});
+
+	Check::Case("resampled voice on a 6 channel device", []
+	{
+		auto Out = Mix(6, 24000, 10);
+		CHECK(Error(Out, 6, 0, PERIOD, Left) < 1e-3f);
+		CHECK(Error(Out, 6, 1, PERIOD, Right) < 1e-3f);
+		for (unsigned c = 2; c < 6; c++)
+			CHECK(Error(Out, 6, c, 0, [](double) { return 0.0f; }) == 0);
+	});
+
+	return Check::Result();
+}
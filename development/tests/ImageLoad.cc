@@ -0,0 +1,81 @@
+#include "Assets/VFS.hh"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Check.hh"
+
+//Loading an image replaces existing nodes with the same name. Paths resolved before must resolve to the new nodes.
+
+using namespace Assets;
+namespace fs = std::filesystem;
+
+namespace
+{
+	std::vector<char> Image(bool Packed)
+	{
+		CVFS Vfs;
+		Vfs.CreateDir("/a/new", true);
+		Vfs.Open("/a/f", FileMode::RW)->Write("new");
+		if(Packed)
+			return Vfs.Pack();
+
+		std::vector<char> Ret;
+		Vfs.Serialize([&Ret](const char *Data, size_t Size) { Ret.insert(Ret.end(), Data, Data + Size); });
+		return Ret;
+	}
+
+	//A tree, whose paths are cached, and which the image replaces. The caller holds the old nodes like open handles
+	//would, so the cache entries stay alive.
+	std::vector<VFSNode> Warm(CVFS &Vfs)
+	{
+		Vfs.CreateDir("/a/old", true);
+		Vfs.Open("/a/f", FileMode::RW)->Write("old");
+		Vfs.Open("/keep", FileMode::RW)->Write("keep");
+
+		std::vector<VFSNode> Ret;
+		for (auto Path : {"/a", "/a/f", "/a/old", "/keep"})
+			Ret.push_back(Vfs.GetNodeInfo(Path));
+
+		return Ret;
+	}
+
+	bool Replaced(CVFS &Vfs, const std::vector<VFSNode> &Old)
+	{
+		auto File = Vfs.GetNodeInfo("/a/f");
+		return Vfs.GetNodeInfo("/a") != Old[0] && File && File != Old[1] && !Vfs.NodeExists("/a/old") && Vfs.NodeExists("/a/new")
+			&& Vfs.Open("/a/f", FileMode::READ)->Read() == "new" && Vfs.GetNodeInfo("/keep") == Old[3];
+	}
+}
+
+int main()
+{
+	for (bool Packed : {false, true})
+	{
+		Check::Case(Packed ? "Deserialize() of a packed image" : "Deserialize()", [Packed]
+		{
+			CVFS Vfs;
+			auto Old = Warm(Vfs);
+			Vfs.Deserialize(Image(Packed));
+			CHECK(Replaced(Vfs, Old));
+		});
+
+		Check::Case(Packed ? "MountImage() of a packed image" : "MountImage()", [Packed]
+		{
+			auto Path = fs::temp_directory_path() / "test_imageload.img";
+			{
+				auto Data = Image(Packed);
+				std::ofstream(Path, std::ios::binary).write(Data.data(), Data.size());
+			}
+
+			CVFS Vfs;
+			auto Old = Warm(Vfs);
+			Vfs.MountImage(Path.string());
+			CHECK(Replaced(Vfs, Old));
+			fs::remove(Path);
+		});
+	}
+
+	return Check::Result();
+}
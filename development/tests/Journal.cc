@@ -0,0 +1,222 @@
+#include "Assets/Journal.hh"
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "Check.hh"
+
+//Journaling of CVFS changes: nodes removed while streams or views still hold them, and replay on a warm path cache.
+
+using namespace Assets;
+namespace fs = std::filesystem;
+
+namespace
+{
+	std::string Dump(CVFS &Vfs, const std::string &Path = "/")
+	{
+		std::string Ret;
+		for (auto &Node : Vfs.List(Path))
+		{
+			std::string Child = (Path == "/" ? "" : Path) + "/" + Node->Name();
+			if(Node->IsDir())
+				Ret += "D " + Child + "\n" + Dump(Vfs, Child);
+			else
+				Ret += "F " + Child + " = " + Vfs.Open(Child, FileMode::READ)->Read() + "\n";
+		}
+
+		return Ret;
+	}
+
+	//Saves through a CVFSJournal on the host and loads the result into a new filesystem.
+	class CSaveDir
+	{
+		public:
+			CSaveDir(const std::string &Name) : m_Dir(fs::temp_directory_path() / ("test_journal_" + Name))
+			{
+				fs::remove_all(m_Dir);
+				fs::create_directories(m_Dir);
+			}
+
+			~CSaveDir()
+			{
+				fs::remove_all(m_Dir);
+			}
+
+			std::string Path() const
+			{
+				return (m_Dir / "save").string();
+			}
+
+			//The reloaded tree matches the saved one and can be journaled further.
+			bool Reloads(CVFS &Saved)
+			{
+				CVFS Loaded;
+				CVFSJournal Journal(Loaded, Path());
+				Journal.Load();
+				if(Dump(Loaded) != Dump(Saved))
+					return false;
+
+				Loaded.Open("/after_load", FileMode::RW)->Write("x");
+				Journal.Save();
+
+				CVFS Again;
+				CVFSJournal(Again, Path()).Load();
+				return Dump(Again) == Dump(Loaded);
+			}
+
+		private:
+			fs::path m_Dir;
+	};
+
+	CVFSWriter::Sink Append(std::vector<char> &Out)
+	{
+		return [&Out](const char *Data, size_t Size) { Out.insert(Out.end(), Data, Data + Size); };
+	}
+}
+
+int main()
+{
+	Check::Case("file deleted while a view is held", []
+	{
+		CSaveDir Dir("view");
+		CVFS Vfs;
+		Vfs.CreateDir("/a");
+		Vfs.Open("/a/f", FileMode::RW)->Write("first");
+
+		CVFSJournal Journal(Vfs, Dir.Path());
+		Journal.Save();
+
+		Vfs.Open("/a/f", FileMode::RW | FileMode::APPEND)->Write(" second");
+		auto View = Vfs.Open("/a/f", FileMode::READ)->ReadView();
+		Vfs.Delete("/a/f");
+		CHECK(Journal.Save());
+
+		CHECK(View.Size() == 12);
+		CHECK(Dir.Reloads(Vfs));
+	});
+
+	Check::Case("dir deleted while a stream writes into it", []
+	{
+		CSaveDir Dir("stream");
+		CVFS Vfs;
+		Vfs.CreateDir("/a/b", true);
+		Vfs.Open("/a/b/f", FileMode::RW)->Write("data");
+		Vfs.Open("/keep", FileMode::RW)->Write("keep");
+
+		CVFSJournal Journal(Vfs, Dir.Path());
+		Journal.Save();
+
+		auto Stream = Vfs.Open("/a/b/f", FileMode::RW | FileMode::APPEND);
+		Stream->Write(" before");
+		Vfs.Delete("/a");
+		Stream->Write(" after");
+		Vfs.Open("/keep", FileMode::RW | FileMode::APPEND)->Write(" more");
+		CHECK(Journal.Save());
+
+		Stream->Write(" next save");
+		Journal.Save();
+		CHECK(Dir.Reloads(Vfs));
+	});
+
+	Check::Case("nodes created in a deleted dir aren't journaled", []
+	{
+		CSaveDir Dir("created");
+		CVFS Vfs;
+		Vfs.CreateDir("/a/b", true);
+
+		CVFSJournal Journal(Vfs, Dir.Path());
+		Journal.Save();
+
+		auto Held = Vfs.GetNodeInfo("/a/b");
+		Vfs.Delete("/a");
+		Vfs.OpenAt(Held, "orphan", FileMode::RW)->Write("orphan");
+		Journal.Save();
+		CHECK(Dir.Reloads(Vfs));
+	});
+
+	Check::Case("replay skips data of files removed in the same segment", []
+	{
+		//Segments as older versions wrote them: the data of a file follows its removal.
+		CVFS Vfs;
+		std::vector<char> Image, Journal;
+		Vfs.Checkpoint(Append(Image));
+		Vfs.Open("/f", FileMode::RW)->Write("abc");
+		Vfs.SaveJournal(Append(Journal));
+
+		std::vector<char> Data, Remove;
+		Vfs.Open("/f", FileMode::RW | FileMode::APPEND)->Write("def");
+		Vfs.SaveJournal(Append(Data));
+		Vfs.Delete("/f");
+		Vfs.SaveJournal(Append(Remove));
+
+		//Header: magic, version, sequence, records size, XXH64 of the records.
+		constexpr size_t HEADER = 4 + 4 + 8 + 8 + 8;
+		std::vector<char> Records(Remove.begin() + HEADER, Remove.end());
+		Records.insert(Records.end(), Data.begin() + HEADER, Data.end());
+
+		std::vector<char> Segment(Data.begin(), Data.begin() + HEADER);
+		uint64_t Size = Records.size(), Checksum = Hash::XXH64(Records.data(), Records.size());
+		memcpy(Segment.data() + 16, &Size, sizeof(Size));
+		memcpy(Segment.data() + 24, &Checksum, sizeof(Checksum));
+		Segment.insert(Segment.end(), Records.begin(), Records.end());
+		Journal.insert(Journal.end(), Segment.begin(), Segment.end());
+
+		CVFS Loaded;
+		Loaded.Deserialize(Image);
+		CHECK(Loaded.ReplayJournal(Journal) == Journal.size());
+		CHECK(!Loaded.NodeExists("/f"));
+	});
+
+	Check::Case("replay invalidates cached paths", []
+	{
+		CVFS Vfs;
+		Vfs.CreateDir("/a/b", true);
+		Vfs.CreateDir("/c");
+		Vfs.Open("/a/x", FileMode::RW)->Write("x");
+		Vfs.Open("/a/y", FileMode::RW)->Write("y");
+
+		std::vector<char> Image, Journal;
+		Vfs.Checkpoint(Append(Image));
+		Vfs.Delete("/a/x");
+		Vfs.Rename("/a/y", "z");
+		Vfs.Move("/a/b", "/c");
+		Vfs.SaveJournal(Append(Journal));
+
+		CVFS Loaded;
+		Loaded.Deserialize(Image);
+		for (auto Path : {"/a/x", "/a/y", "/a/b"})
+			CHECK(Loaded.NodeExists(Path));
+
+		Loaded.ReplayJournal(Journal);
+		for (auto Path : {"/a/x", "/a/y", "/a/b"})
+			CHECK(!Loaded.NodeExists(Path));
+
+		CHECK(Loaded.NodeExists("/a/z"));
+		CHECK(Loaded.NodeExists("/c/b"));
+		CHECK(Dump(Loaded) == Dump(Vfs));
+	});
+
+	Check::Case("journal round trip", []
+	{
+		CSaveDir Dir("roundtrip");
+		CVFS Vfs;
+		Vfs.CreateDir("/a/b", true);
+		Vfs.Open("/a/x", FileMode::RW)->Write(std::string(10000, 'x'));
+
+		CVFSJournal Journal(Vfs, Dir.Path());
+		Journal.Save();
+		CHECK(!Journal.Save());
+
+		Vfs.Open("/a/x", FileMode::RW | FileMode::APPEND)->Write("appended");
+		Vfs.Open("/a/b/y", FileMode::RW)->Write("y");
+		Vfs.Rename("/a/b/y", "z");
+		Vfs.CreateDir("/c");
+		Vfs.Move("/a/b", "/c");
+		Vfs.Copy("/a", "/copy");
+		Vfs.Open("/a/x", FileMode::WRITE)->Write("rewritten");
+		CHECK(Journal.Save());
+		CHECK(Dir.Reloads(Vfs));
+	});
+
+	return Check::Result();
+}
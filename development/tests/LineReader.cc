@@ -0,0 +1,81 @@
+#include <chrono>
+#include <string>
+#include <string_view>
+
+//The test looks at the read buffer of the stream, so it needs its internals.
+#define private public
+#include "Assets/VFS.hh"
+#undef private
+
+#include "Check.hh"
+
+//Line reading of CVFSFileStream on files, which grow while the stream is open. The read buffer starts at the size
+//of the file and must grow with it.
+
+using namespace Assets;
+
+namespace
+{
+	std::string Lines(size_t Count)
+	{
+		std::string Ret;
+		for (size_t i = 0; i < Count; i++)
+			Ret += "line " + std::to_string(i) + "\n";
+
+		return Ret;
+	}
+
+	//Reads the rest of the stream, returns the lines joined by line breaks.
+	std::string ReadAll(CVFSFileStream &Stream)
+	{
+		std::string Ret;
+		std::string_view Line;
+		while (Stream.ReadLine(Line))
+			Ret.append(Line).append("\n");
+
+		return Ret;
+	}
+}
+
+int main()
+{
+	Check::Case("empty file, which grows", []
+	{
+		CVFS Vfs;
+		auto Reader = Vfs.Open("/log", FileMode::RW);
+		CHECK(ReadAll(*Reader).empty());
+
+		auto Data = Lines(20000);
+		Vfs.Open("/log", FileMode::WRITE | FileMode::APPEND)->Write(Data);
+		CHECK(ReadAll(*Reader) == Data);
+		CHECK(Reader->m_Buffer.size() == CVFSFileStream::LINE_BUFFER_SIZE);
+	});
+
+	Check::Case("small file, which grows after it was read", []
+	{
+		CVFS Vfs;
+		auto Head = Lines(3);
+		Vfs.Open("/log", FileMode::RW)->Write(Head);
+
+		auto Reader = Vfs.Open("/log", FileMode::READ);
+		CHECK(ReadAll(*Reader) == Head);
+		CHECK(Reader->m_Buffer.size() == Head.size());
+
+		auto Tail = Lines(20000).substr(Head.size());
+		Vfs.Open("/log", FileMode::WRITE | FileMode::APPEND)->Write(Tail);
+		CHECK(ReadAll(*Reader) == Tail);
+		CHECK(Reader->m_Buffer.size() == CVFSFileStream::LINE_BUFFER_SIZE);
+	});
+
+	Check::Case("small file keeps a small buffer", []
+	{
+		CVFS Vfs;
+		Vfs.Open("/small", FileMode::RW)->Write("a\nb\n");
+
+		auto Reader = Vfs.Open("/small", FileMode::READ);
+		CHECK(ReadAll(*Reader) == "a\nb\n");
+		CHECK(Reader->m_Buffer.size() == 4);
+	});
+
+	return Check::Result();
+}
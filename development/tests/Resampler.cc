@@ -0,0 +1,152 @@
+#include "Audio/Resampler.hh"
+#include <cmath>
+#include <vector>
+
+#include "Check.hh"
+
+//Quality of the voice resampler: distortion of pure tones, passband flatness and suppression of tones above the
+//output's Nyquist frequency. Every measurement prints its value, the limits leave a few dB to the current filter.
+
+using namespace Audio;
+
+namespace
+{
+	constexpr double PI = 3.14159265358979323846;
+	constexpr double AMPLITUDE = 0.5;
+	constexpr size_t FRAMES = 96000;
+
+	std::vector<float> Tone(double Freq, unsigned Rate)
+	{
+		std::vector<float> Ret(FRAMES * 2);
+		for (size_t i = 0; i < FRAMES; i++)
+			Ret[i * 2] = Ret[i * 2 + 1] = float(AMPLITUDE * std::sin(2 * PI * Freq * i / Rate));
+
+		return Ret;
+	}
+
+	//Runs Process() over the whole input, Convert() has no pitch.
+	std::vector<float> Resample(const std::vector<float> &In, unsigned From, unsigned To, double Pitch = 1.0)
+	{
+		const double Step = double(From) / To * Pitch;
+		std::vector<float> Ret(size_t(In.size() / 2 / Step + 1) * 2), Scratch(Resampler::scratchSamples);
+		Resampler::State State;
+		size_t Read = 0;
+		auto Frames = Resampler::Process(State, Ret.data(), unsigned(Ret.size() / 2), Step, Scratch.data(), [&](float *Dst, size_t Count)
+		{
+			Count = std::min(Count, In.size() / 2 - Read);
+			std::copy_n(In.data() + Read * 2, Count * 2, Dst);
+			Read += Count;
+			return Count;
+		});
+
+		Ret.resize(size_t(Frames) * 2);
+		return Ret;
+	}
+
+	//Level of everything but the tone relative to the tone (THD+N) in dB. The tone is fitted by least squares
+	//over the middle half, so the filter's delay and the edges don't count.
+	double Distortion(const std::vector<float> &Out, double Freq, unsigned Rate)
+	{
+		size_t Frames = Out.size() / 2, Begin = Frames / 4, End = Frames * 3 / 4;
+		double SS = 0, CC = 0, SC = 0, YS = 0, YC = 0;
+		for (size_t i = Begin; i < End; i++)
+		{
+			double S = std::sin(2 * PI * Freq * i / Rate), C = std::cos(2 * PI * Freq * i / Rate);
+			SS += S * S;
+			CC += C * C;
+			SC += S * C;
+			YS += Out[i * 2] * S;
+			YC += Out[i * 2] * C;
+		}
+
+		double Det = SS * CC - SC * SC, A = (YS * CC - YC * SC) / Det, B = (YC * SS - YS * SC) / Det;
+		double Residual = 0, Power = 0;
+		for (size_t i = Begin; i < End; i++)
+		{
+			double Fit = A * std::sin(2 * PI * Freq * i / Rate) + B * std::cos(2 * PI * Freq * i / Rate);
+			Residual += (Out[i * 2] - Fit) * (Out[i * 2] - Fit);
+			Power += Fit * Fit;
+		}
+
+		return 10 * std::log10(Residual / Power);
+	}
+
+	//Output level over the middle half relative to the input tone in dB.
+	double Gain(const std::vector<float> &Out)
+	{
+		size_t Frames = Out.size() / 2, Begin = Frames / 4, End = Frames * 3 / 4;
+		double Sum = 0;
+		for (size_t i = Begin; i < End; i++)
+			Sum += Out[i * 2] * Out[i * 2];
+
+		return 20 * std::log10(std::sqrt(Sum / (End - Begin)) / (AMPLITUDE / std::sqrt(2.0)));
+	}
+}
+
+int main()
+{
+	Resampler::Init();
+
+	Check::Case("THD+N of tones up to 18 kHz", []
+	{
+		for (auto [From, To] : {std::pair{44100u, 48000u}, std::pair{48000u, 44100u}})
+		{
+			for (double Freq : {1000.0, 5000.0, 10000.0, 15000.0, 18000.0})
+			{
+				double Db = Distortion(Resample(Tone(Freq, From), From, To), Freq, To);
+				printf("  %5u -> %5u Hz, %5.0f Hz: %6.1f dB\n", From, To, Freq, Db);
+				CHECK(Db < -80);
+			}
+		}
+	});
+
+	Check::Case("passband is flat up to 16 kHz", []
+	{
+		for (double Freq : {1000.0, 10000.0, 16000.0})
+		{
+			double Db = Gain(Resample(Tone(Freq, 44100), 44100, 48000));
+			printf("  44100 -> 48000 Hz, %5.0f Hz: %6.2f dB\n", Freq, Db);
+			CHECK(std::fabs(Db) < 0.1);
+		}
+	});
+
+	Check::Case("tones above the output Nyquist don't alias", []
+	{
+		for (double Freq : {23000.0, 23500.0})
+		{
+			double Db = Gain(Resample(Tone(Freq, 48000), 48000, 44100));
+			printf("  48000 -> 44100 Hz, %5.0f Hz: %6.1f dB\n", Freq, Db);
+			CHECK(Db < -80);
+		}
+
+		//Pitch 2 halves the cutoff, 15 kHz lands at 30 kHz.
+		for (double Freq : {15000.0, 20000.0})
+		{
+			double Db = Gain(Resample(Tone(Freq, 44100), 44100, 48000, 2.0));
+			printf("  44100 -> 48000 Hz, pitch 2, %5.0f Hz: %6.1f dB\n", Freq, Db);
+			CHECK(Db < -80);
+		}
+	});
+
+	Check::Case("pitch scales the frequency", []
+	{
+		double Db = Distortion(Resample(Tone(1000, 44100), 44100, 48000, 2.0), 2000, 48000);
+		printf("  44100 -> 48000 Hz, pitch 2, 1 kHz as 2 kHz: %6.1f dB\n", Db);
+		CHECK(Db < -80);
+	});
+
+	Check::Case("output length follows the step", []
+	{
+		auto In = Tone(1000, 44100);
+		for (double Pitch : {0.5, 1.0, 1.25, 2.0})
+		{
+			double Expected = FRAMES * 48000.0 / 44100 / Pitch;
+			CHECK(std::fabs(Resample(In, 44100, 48000, Pitch).size() / 2 - Expected) <= 1);
+		}
+
+		CHECK(std::fabs(Resampler::Convert(In.data(), FRAMES, 48000, 44100).size() / 2 - FRAMES * 44100.0 / 48000) <= 1);
+		CHECK(Resampler::Convert(In.data(), 0, 48000, 44100).empty());
+	});
+
+	return Check::Result();
+}
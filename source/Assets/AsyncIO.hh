@@ -0,0 +1,308 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <queue>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <cstdint>
+
+#include "VFS.hh"
+#include "HostFile.hh"
+
+namespace Assets {
+
+class CIORequest;
+using IORequest = std::shared_ptr<CIORequest>;
+
+enum class IOPriority
+{
+	LOW,
+	NORMAL,
+	HIGH
+};
+
+enum class IOState
+{
+	PENDING,
+	RUNNING,
+	DONE,
+	FAILED,
+	CANCELLED
+};
+
+//Byte range of a read, the size is clamped to the end of the file.
+struct SIORange
+{
+	uint64_t Offset = 0;
+	size_t Size = SIZE_MAX;
+};
+
+//Handle of a queued read. The result is a CVFSView, so reads of VFS files don't copy.
+class CIORequest
+{
+	friend class CAsyncIO;
+
+	public:
+		using Callback = std::function<void(const IORequest&)>;
+
+		//Cancels the request. Queued requests are dropped, running host reads stop at the next piece.
+		void Cancel()
+		{
+			m_Cancel = true;
+		}
+
+		IOState State() const
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			return m_State;
+		}
+
+		bool IsDone() const
+		{
+			IOState State = this->State();
+			return State != IOState::PENDING && State != IOState::RUNNING;
+		}
+
+		void Wait() const
+		{
+			std::unique_lock<std::mutex> lock(m_Lock);
+			m_Done.wait(lock, [this] { return m_State != IOState::PENDING && m_State != IOState::RUNNING; });
+		}
+
+		//Waits for the request and returns the data. Throws the error of a failed or cancelled request.
+		const CVFSView &Get() const
+		{
+			Wait();
+			if(m_Error)
+				std::rethrow_exception(m_Error);
+
+			return m_Result;
+		}
+
+	private:
+		std::function<void(CIORequest&)> m_Work;
+		Callback m_Callback;
+		IOPriority m_Priority;
+		uint64_t m_Sequence;
+
+		std::atomic<bool> m_Cancel{false};
+		IOState m_State = IOState::PENDING;
+		CVFSView m_Result;
+		std::exception_ptr m_Error;
+
+		mutable std::mutex m_Lock;
+		mutable std::condition_variable m_Done;
+};
+
+//Request queue serviced by worker threads, which read host files and VFS files in the background.
+//Requests with a higher priority run first, requests with the same priority in submission order.
+//The number of workers is the queue depth, i.e. the number of reads in flight.
+class CAsyncIO
+{
+	public:
+		CAsyncIO(size_t Workers = 4)
+		{
+			Workers = std::max<size_t>(Workers, 1);
+			for (size_t i = 0; i < Workers; i++)
+				m_Workers.emplace_back([this] { WorkerLoop(); });
+		}
+
+		CAsyncIO(const CAsyncIO&) = delete;
+		CAsyncIO &operator=(const CAsyncIO&) = delete;
+
+		//Reads a range of a host file.
+		IORequest ReadAsync(const std::string &HostPath, SIORange Range = SIORange(), IOPriority Priority = IOPriority::NORMAL, CIORequest::Callback Callback = nullptr)
+		{
+			return Submit([HostPath, Range](CIORequest &Request)
+			{
+				ReadHostFile(HostPath, Range, Request);
+			}, Priority, std::move(Callback));
+		}
+
+		//Reads a range of a VFS file. The filesystem has to outlive the request.
+		IORequest ReadAsync(CVFS &Vfs, const std::string &Path, SIORange Range = SIORange(), IOPriority Priority = IOPriority::NORMAL, CIORequest::Callback Callback = nullptr)
+		{
+			return Submit([&Vfs, Path, Range](CIORequest &Request)
+			{
+				auto Stream = Vfs.Open(Path, FileMode::READ);
+				if(Range.Offset > Stream->Size())
+					return;
+
+				Stream->Seek(Cursor::BEG, Range.Offset);
+				Request.m_Result = Stream->ReadView(Range.Size);
+			}, Priority, std::move(Callback));
+		}
+
+		size_t Pending() const
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			return m_Queue.size();
+		}
+
+		~CAsyncIO()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_Lock);
+				m_Stopping = true;
+			}
+
+			m_HasWork.notify_all();
+			for (auto &&e : m_Workers)
+				e.join();
+
+			while (!m_Queue.empty())   //Requests, which never ran, are cancelled.
+			{
+				Finish(*m_Queue.top(), IOState::CANCELLED, std::make_exception_ptr(CVFSException("Read cancelled.", VFSError::IO_CANCELLED)));
+				m_Queue.pop();
+			}
+		}
+
+	private:
+		static constexpr size_t READ_PIECE = 1024 * 1024;  //Cancellation is checked between pieces.
+
+		struct SCompare
+		{
+			bool operator()(const IORequest &a, const IORequest &b) const
+			{
+				if(a->m_Priority != b->m_Priority)
+					return a->m_Priority < b->m_Priority;
+
+				return a->m_Sequence > b->m_Sequence;
+			}
+		};
+
+		IORequest Submit(std::function<void(CIORequest&)> Work, IOPriority Priority, CIORequest::Callback Callback)
+		{
+			auto Request = std::make_shared<CIORequest>();
+			Request->m_Work = std::move(Work);
+			Request->m_Callback = std::move(Callback);
+			Request->m_Priority = Priority;
+
+			{
+				std::lock_guard<std::mutex> lock(m_Lock);
+				Request->m_Sequence = m_Sequence++;
+				m_Queue.push(Request);
+			}
+
+			m_HasWork.notify_one();
+			return Request;
+		}
+
+		void WorkerLoop()
+		{
+			for (;;)
+			{
+				IORequest Request;
+				{
+					std::unique_lock<std::mutex> lock(m_Lock);
+					m_HasWork.wait(lock, [this] { return m_Stopping || !m_Queue.empty(); });
+					if(m_Stopping)
+						return;
+
+					Request = m_Queue.top();
+					m_Queue.pop();
+				}
+
+				Run(Request);
+			}
+		}
+
+		void Run(const IORequest &Request)
+		{
+			if(Request->m_Cancel)
+			{
+				Finish(*Request, IOState::CANCELLED, std::make_exception_ptr(CVFSException("Read cancelled.", VFSError::IO_CANCELLED)));
+			}
+			else
+			{
+				{
+					std::lock_guard<std::mutex> lock(Request->m_Lock);
+					Request->m_State = IOState::RUNNING;
+				}
+
+				try
+				{
+					Request->m_Work(*Request);
+					if(Request->m_Cancel)
+						throw CVFSException("Read cancelled.", VFSError::IO_CANCELLED);
+
+					Finish(*Request, IOState::DONE, nullptr);
+				}
+				catch(const CVFSException &e)
+				{
+					Finish(*Request, e.GetErrType() == VFSError::IO_CANCELLED ? IOState::CANCELLED : IOState::FAILED, std::current_exception());
+				}
+				catch(...)
+				{
+					Finish(*Request, IOState::FAILED, std::current_exception());
+				}
+			}
+
+			if(Request->m_Callback)
+				Request->m_Callback(Request);
+
+			Request->m_Work = nullptr;  //Releases the captures, e.g. the path.
+		}
+
+		static void Finish(CIORequest &Request, IOState State, std::exception_ptr Error)
+		{
+			{
+				std::lock_guard<std::mutex> lock(Request.m_Lock);
+				Request.m_State = State;
+				Request.m_Error = Error;
+				if(Error)
+					Request.m_Result = CVFSView();
+			}
+
+			Request.m_Done.notify_all();
+		}
+
+		static void ReadHostFile(const std::string &Path, SIORange Range, CIORequest &Request)
+		{
+			CHostFile File(Path);
+			if(!File.IsOpen())
+				throw CVFSException("Can't open file: " + Path, VFSError::CANT_OPEN_FILE);
+
+			std::shared_ptr<std::vector<char>> Buf;
+			size_t Count = Range.Offset < File.Size() ? (size_t)std::min<uint64_t>(Range.Size, File.Size() - Range.Offset) : 0;
+			try
+			{
+				Buf = std::make_shared<std::vector<char>>(Count);
+			}
+			catch(const std::bad_alloc &e)
+			{
+				throw CVFSException("Can't read file. Out of mem. bad_alloc: " + std::string(e.what()), VFSError::OUT_OF_MEM);
+			}
+
+			size_t Done = 0;
+			while (Done < Count && !Request.m_Cancel)
+			{
+				long long Readed = File.ReadAt(Buf->data() + Done, std::min(READ_PIECE, Count - Done), Range.Offset + Done);
+				if(Readed < 0)
+					throw CVFSException("Can't read file: " + Path, VFSError::FAILED_TO_READ_STREAM);
+
+				if(Readed == 0) //The file was truncated in the meantime.
+					break;
+
+				Done += Readed;
+			}
+
+			Request.m_Result.Append(Buf->data(), Done, Buf);
+		}
+
+		std::vector<std::thread> m_Workers;
+		std::priority_queue<IORequest, std::vector<IORequest>, SCompare> m_Queue;
+		uint64_t m_Sequence = 0;
+		bool m_Stopping = false;
+
+		mutable std::mutex m_Lock;
+		std::condition_variable m_HasWork;
+};
+
+} // namespace Assets
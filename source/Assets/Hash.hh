@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string.h>
+
+//Fast non cryptographic hashing (XXH64) for content addressing of chunks and blocks.
+namespace Assets::Hash {
+
+namespace Internal {
+
+constexpr uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t PRIME3 = 0x165667B19E3779F9ull;
+constexpr uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t PRIME5 = 0x27D4EB2F165667C5ull;
+
+inline uint64_t Rotl(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t Read64(const char *Src)
+{
+	uint64_t Ret;
+	memcpy(&Ret, Src, sizeof(Ret));
+	return Ret;
+}
+
+inline uint32_t Read32(const char *Src)
+{
+	uint32_t Ret;
+	memcpy(&Ret, Src, sizeof(Ret));
+	return Ret;
+}
+
+inline uint64_t Round(uint64_t Acc, uint64_t Input)
+{
+	Acc += Input * PRIME2;
+	Acc = Rotl(Acc, 31);
+	return Acc * PRIME1;
+}
+
+inline uint64_t MergeRound(uint64_t Acc, uint64_t Val)
+{
+	Acc ^= Round(0, Val);
+	return Acc * PRIME1 + PRIME4;
+}
+
+} // namespace Internal
+
+inline uint64_t XXH64(const void *Data, size_t Size, uint64_t Seed = 0)
+{
+	using namespace Internal;
+
+	const char *p = (const char*)Data;
+	const char *End = p + Size;
+	uint64_t h;
+
+	if(Size >= 32)
+	{
+		uint64_t v1 = Seed + PRIME1 + PRIME2;
+		uint64_t v2 = Seed + PRIME2;
+		uint64_t v3 = Seed;
+		uint64_t v4 = Seed - PRIME1;
+
+		for (; End - p >= 32; p += 32)
+		{
+			v1 = Round(v1, Read64(p));
+			v2 = Round(v2, Read64(p + 8));
+			v3 = Round(v3, Read64(p + 16));
+			v4 = Round(v4, Read64(p + 24));
+		}
+
+		h = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+		h = MergeRound(h, v1);
+		h = MergeRound(h, v2);
+		h = MergeRound(h, v3);
+		h = MergeRound(h, v4);
+	}
+	else
+		h = Seed + PRIME5;
+
+	h += Size;
+
+	for (; End - p >= 8; p += 8)
+		h = Rotl(h ^ Round(0, Read64(p)), 27) * PRIME1 + PRIME4;
+
+	if(End - p >= 4)
+	{
+		h = Rotl(h ^ (Read32(p) * PRIME1), 23) * PRIME2 + PRIME3;
+		p += 4;
+	}
+
+	for (; p < End; p++)
+		h = Rotl(h ^ ((uint8_t)*p * PRIME5), 11) * PRIME1;
+
+	h ^= h >> 33;
+	h *= PRIME2;
+	h ^= h >> 29;
+	h *= PRIME3;
+	h ^= h >> 32;
+	return h;
+}
+
+//128 bit key from two independent 64 bit hashes, used where the data isn't compared after a match.
+struct SHash128
+{
+	uint64_t Low;
+	uint64_t High;
+
+	bool operator==(const SHash128 &Other) const
+	{
+		return Low == Other.Low && High == Other.High;
+	}
+};
+
+struct SHash128Hasher
+{
+	size_t operator()(const SHash128 &Hash) const
+	{
+		return (size_t)Hash.Low;
+	}
+};
+
+inline SHash128 Hash128(const void *Data, size_t Size)
+{
+	return SHash128{XXH64(Data, Size, 0), XXH64(Data, Size, Internal::PRIME3)};
+}
+
+} // namespace Assets::Hash
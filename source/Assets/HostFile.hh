@@ -0,0 +1,143 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <cerrno>
+
+#ifdef _WIN32
+#	ifndef WIN32_LEAN_AND_MEAN
+#		define WIN32_LEAN_AND_MEAN
+#	endif
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+namespace Assets {
+
+//Read only host file with positioned reads (pread / ReadFile with an offset),
+//so several threads can read the same file without sharing a file position.
+class CHostFile
+{
+	public:
+		CHostFile(const std::string &Path)
+		{
+#ifdef _WIN32
+			m_File = CreateFileA(Path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+			if(m_File == INVALID_HANDLE_VALUE)
+				return;
+
+			LARGE_INTEGER Size;
+			if(!GetFileSizeEx(m_File, &Size))
+			{
+				CloseHandle(m_File);
+				m_File = INVALID_HANDLE_VALUE;
+				return;
+			}
+
+			m_Size = (uint64_t)Size.QuadPart;
+#else
+			m_File = open(Path.c_str(), O_RDONLY);
+			if(m_File < 0)
+				return;
+
+			struct stat St;
+			if(fstat(m_File, &St) != 0)
+			{
+				close(m_File);
+				m_File = -1;
+				return;
+			}
+
+			m_Size = (uint64_t)St.st_size;
+#endif
+		}
+
+		CHostFile(const CHostFile&) = delete;
+		CHostFile &operator=(const CHostFile&) = delete;
+
+		inline bool IsOpen() const
+		{
+#ifdef _WIN32
+			return m_File != INVALID_HANDLE_VALUE;
+#else
+			return m_File >= 0;
+#endif
+		}
+
+		inline uint64_t Size() const
+		{
+			return m_Size;
+		}
+
+		//Returns the number of read bytes, 0 at the end of the file or -1 on errors.
+		long long ReadAt(char *Buf, size_t Count, uint64_t Pos) const
+		{
+#ifdef _WIN32
+			OVERLAPPED Overlapped{};
+			Overlapped.Offset = (DWORD)Pos;
+			Overlapped.OffsetHigh = (DWORD)(Pos >> 32);
+
+			DWORD Readed = 0;
+			if(!ReadFile(m_File, Buf, (DWORD)Count, &Readed, &Overlapped))
+				return GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+
+			return Readed;
+#else
+			ssize_t Readed;
+			do
+			{
+				Readed = pread(m_File, Buf, Count, (off_t)Pos);
+			} while (Readed < 0 && errno == EINTR);
+
+			return Readed;
+#endif
+		}
+
+		//Reads until Count bytes are read or the file ends, returns the number of read bytes or -1 on errors.
+		long long ReadFullAt(char *Buf, size_t Count, uint64_t Pos) const
+		{
+			size_t Done = 0;
+			while (Done < Count)
+			{
+				long long Readed = ReadAt(Buf + Done, Count - Done, Pos + Done);
+				if(Readed < 0)
+					return -1;
+
+				if(Readed == 0)
+					break;
+
+				Done += Readed;
+			}
+
+			return Done;
+		}
+
+		~CHostFile()
+		{
+#ifdef _WIN32
+			if(m_File != INVALID_HANDLE_VALUE)
+				CloseHandle(m_File);
+#else
+			if(m_File >= 0)
+				close(m_File);
+#endif
+		}
+
+	private:
+		uint64_t m_Size = 0;
+
+#ifdef _WIN32
+		HANDLE m_File = INVALID_HANDLE_VALUE;
+#else
+		int m_File = -1;
+#endif
+};
+
+} // namespace Assets
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <utility>
+#include <filesystem>
+#include <cstdint>
+
+#ifdef _WIN32
+#	include <io.h>
+#	include <fcntl.h>
+#	include <sys/stat.h>
+#else
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
+#include "VFS.hh"
+#include "HostFile.hh"
+
+namespace Assets {
+
+//Keeps a CVFS on the host as checkpoint image (Path) plus an append only journal (Path + ".journal").
+//Save() appends only the changes since the last save. Once the journal outgrows CompactSize, it's moved
+//aside and merged into a new checkpoint on a background thread, while saves continue into a new journal.
+class CVFSJournal
+{
+	public:
+		CVFSJournal(CVFS &Vfs, const std::string &Path, uint64_t CompactSize = 64 * 1024 * 1024) : m_Vfs(Vfs), m_Path(Path), m_CompactSize(CompactSize) {}
+
+		CVFSJournal(const CVFSJournal&) = delete;
+		CVFSJournal &operator=(const CVFSJournal&) = delete;
+
+		//Loads the checkpoint and replays the journals. The tail of an interrupted save is cut off.
+		void Load()
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			JoinCompaction();
+
+			auto Image = ReadHostFile(m_Path);
+			if(Image.empty())   //Nothing saved yet, the first save writes the checkpoint.
+				return;
+
+			m_Vfs.Deserialize(Image);
+			Image = std::vector<char>();
+
+			for (auto &&Path : {OldJournalPath(), JournalPath()})
+			{
+				auto Journal = ReadHostFile(Path);
+				size_t Intact = m_Vfs.ReplayJournal(Journal);
+				if(Intact != Journal.size())
+					std::filesystem::resize_file(Path, Intact);
+			}
+
+			m_JournalSize = FileSize(JournalPath());
+		}
+
+		//Stores the changes since the last save, the first save writes a checkpoint.
+		//Returns false, if nothing changed.
+		bool Save()
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			if(!m_Vfs.Journaling())
+			{
+				WriteCheckpoint();
+				return true;
+			}
+
+			bool Ret = false;
+			WriteHostFile(JournalPath(), true, [&](int Fd) { Ret = m_Vfs.SaveJournal(Fd); });
+			if(Ret)
+				m_JournalSize = FileSize(JournalPath());
+
+			if(m_JournalSize >= m_CompactSize)
+				StartCompaction();
+
+			return Ret;
+		}
+
+		//Starts merging the journal into the checkpoint. Returns false, if a compaction is still running.
+		bool Compact()
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			return StartCompaction();
+		}
+
+		//Waits for a running compaction and rethrows its error.
+		void WaitCompaction()
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			JoinCompaction();
+			if(m_Error)
+				std::rethrow_exception(std::exchange(m_Error, nullptr));
+		}
+
+		~CVFSJournal()
+		{
+			if(m_Compactor.joinable())
+				m_Compactor.join();
+		}
+
+	private:
+		std::string JournalPath() const
+		{
+			return m_Path + ".journal";
+		}
+
+		//The journal, which is merged by the running or an interrupted compaction.
+		std::string OldJournalPath() const
+		{
+			return m_Path + ".journal.old";
+		}
+
+		void JoinCompaction()
+		{
+			if(m_Compactor.joinable())
+				m_Compactor.join();
+		}
+
+		bool StartCompaction()
+		{
+			if(m_Compactor.joinable())
+			{
+				if(m_Compacting)
+					return false;
+
+				m_Compactor.join();
+			}
+
+			//A journal left by an interrupted compaction is merged first.
+			std::error_code Err;
+			if(!std::filesystem::exists(OldJournalPath(), Err))
+			{
+				if(m_JournalSize == 0)
+					return false;
+
+				std::filesystem::rename(JournalPath(), OldJournalPath());
+				m_JournalSize = 0;
+			}
+
+			m_Compacting = true;
+			m_Compactor = std::thread([this]()
+			{
+				try
+				{
+					Merge(m_Path, OldJournalPath());
+				}
+				catch(...)
+				{
+					m_Error = std::current_exception();
+				}
+
+				m_Compacting = false;
+			});
+
+			return true;
+		}
+
+		//Writes the checkpoint of the image and the journal. Only files of the host are touched,
+		//so this runs without stopping the filesystem, which is saved.
+		static void Merge(const std::string &Path, const std::string &JournalPath)
+		{
+			CVFS Merged;
+			Merged.Deserialize(ReadHostFile(Path));
+			Merged.ReplayJournal(ReadHostFile(JournalPath));
+
+			WriteHostFile(Path + ".tmp", false, [&](int Fd) { Merged.Checkpoint(Fd); });
+			std::filesystem::rename(Path + ".tmp", Path);
+			std::filesystem::remove(JournalPath);
+		}
+
+		//Replaces the saved state with a new checkpoint. The old journals are removed first,
+		//an interruption leaves the old checkpoint without its journal.
+		void WriteCheckpoint()
+		{
+			JoinCompaction();
+			WriteHostFile(m_Path + ".tmp", false, [&](int Fd) { m_Vfs.Checkpoint(Fd); });
+
+			std::filesystem::remove(OldJournalPath());
+			std::filesystem::remove(JournalPath());
+			std::filesystem::rename(m_Path + ".tmp", m_Path);
+			m_JournalSize = 0;
+		}
+
+		static uint64_t FileSize(const std::string &Path)
+		{
+			std::error_code Err;
+			uint64_t Ret = std::filesystem::file_size(Path, Err);
+			return Err ? 0 : Ret;
+		}
+
+		//Returns the content of the file, missing files are empty.
+		static std::vector<char> ReadHostFile(const std::string &Path)
+		{
+			CHostFile File(Path);
+			if(!File.IsOpen())
+				return std::vector<char>();
+
+			std::vector<char> Ret(File.Size());
+			long long Readed = File.ReadFullAt(Ret.data(), Ret.size(), 0);
+			if(Readed < 0)
+				throw CVFSException("Can't read file: " + Path, VFSError::FAILED_TO_READ_STREAM);
+
+			Ret.resize(Readed);
+			return Ret;
+		}
+
+		//Opens the file, passes the descriptor to Write and flushes the file to the disk.
+		static void WriteHostFile(const std::string &Path, bool Append, const std::function<void(int)> &Write)
+		{
+#ifdef _WIN32
+			int Fd = _open(Path.c_str(), _O_WRONLY | _O_CREAT | _O_BINARY | (Append ? _O_APPEND : _O_TRUNC), _S_IREAD | _S_IWRITE);
+#else
+			int Fd = open(Path.c_str(), O_WRONLY | O_CREAT | (Append ? O_APPEND : O_TRUNC), 0644);
+#endif
+			if(Fd < 0)
+				throw CVFSException("Can't open file: " + Path, VFSError::CANT_OPEN_FILE);
+
+			try
+			{
+				Write(Fd);
+#ifdef _WIN32
+				if(_commit(Fd) != 0)
+#else
+				if(fsync(Fd) != 0)
+#endif
+					throw CVFSException("Can't write file: " + Path, VFSError::FAILED_TO_WRITE_STREAM);
+			}
+			catch(...)
+			{
+#ifdef _WIN32
+				_close(Fd);
+#else
+				close(Fd);
+#endif
+				throw;
+			}
+
+#ifdef _WIN32
+			_close(Fd);
+#else
+			close(Fd);
+#endif
+		}
+
+		CVFS &m_Vfs;
+		std::string m_Path;
+		uint64_t m_CompactSize;
+		uint64_t m_JournalSize = 0;
+
+		std::thread m_Compactor;
+		std::atomic<bool> m_Compacting{false};
+		std::exception_ptr m_Error;
+		std::mutex m_Lock;
+};
+
+} // namespace Assets
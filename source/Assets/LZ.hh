@@ -0,0 +1,199 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string.h>
+
+//Small byte oriented LZ77 codec (LZ4 like) for the blocks of packed disk images.
+//A block is a list of sequences: token, literal length, literals, offset, match length.
+//The high nibble of the token is the literal length, the low nibble the match length - MIN_MATCH,
+//15 means the length continues in the following bytes (255 = continue).
+//The last sequence only has literals.
+namespace Assets::LZ {
+
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t MAX_OFFSET = 65535;
+constexpr int HASH_BITS = 14;
+
+inline size_t CompressBound(size_t Size)
+{
+	return Size + Size / 255 + 16;
+}
+
+namespace Internal {
+
+inline uint32_t Read32(const char *Src)
+{
+	uint32_t Ret;
+	memcpy(&Ret, Src, sizeof(Ret));
+	return Ret;
+}
+
+inline uint32_t Hash(uint32_t Seq)
+{
+	return (Seq * 2654435761u) >> (32 - HASH_BITS);
+}
+
+inline bool WriteLength(char *&Op, const char *OEnd, size_t Len)
+{
+	for (; Len >= 255; Len -= 255)
+	{
+		if(Op >= OEnd)
+			return false;
+
+		*Op++ = (char)255;
+	}
+
+	if(Op >= OEnd)
+		return false;
+
+	*Op++ = (char)Len;
+	return true;
+}
+
+inline bool ReadLength(const char *&Ip, const char *IEnd, size_t &Len)
+{
+	uint8_t c;
+	do
+	{
+		if(Ip >= IEnd)
+			return false;
+
+		c = (uint8_t)*Ip++;
+		Len += c;
+	} while (c == 255);
+
+	return true;
+}
+
+inline bool WriteSequence(char *&Op, const char *OEnd, const char *Literals, size_t LitLen, size_t Offset, size_t MatchLen)
+{
+	if(Op >= OEnd)
+		return false;
+
+	char *Token = Op++;
+	size_t MatchCode = MatchLen ? MatchLen - MIN_MATCH : 0;
+	*Token = (char)(((LitLen >= 15 ? 15 : LitLen) << 4) | (MatchCode >= 15 ? 15 : MatchCode));
+
+	if(LitLen >= 15 && !WriteLength(Op, OEnd, LitLen - 15))
+		return false;
+
+	if((size_t)(OEnd - Op) < LitLen)
+		return false;
+
+	memcpy(Op, Literals, LitLen);
+	Op += LitLen;
+
+	if(MatchLen == 0)   //Last sequence.
+		return true;
+
+	if(OEnd - Op < 2)
+		return false;
+
+	*Op++ = (char)(Offset & 0xFF);
+	*Op++ = (char)(Offset >> 8);
+
+	return MatchCode < 15 || WriteLength(Op, OEnd, MatchCode - 15);
+}
+
+} // namespace Internal
+
+//Returns the compressed size or 0, if the result doesn't fit into Dst.
+inline size_t Compress(const char *Src, size_t Size, char *Dst, size_t Capacity)
+{
+	using namespace Internal;
+
+	uint32_t Table[1 << HASH_BITS] = {};
+	char *Op = Dst;
+	const char *OEnd = Dst + Capacity;
+	size_t Ip = 1;
+	size_t Anchor = 0;
+
+	while (Ip + MIN_MATCH <= Size)
+	{
+		uint32_t Seq = Read32(Src + Ip);
+		uint32_t &Slot = Table[Hash(Seq)];
+		size_t Candidate = Slot;
+		Slot = (uint32_t)Ip;
+
+		if(Ip - Candidate > MAX_OFFSET || Read32(Src + Candidate) != Seq)
+		{
+			Ip += 1 + ((Ip - Anchor) >> 6);    //Skips faster through data, which doesn't compress.
+			continue;
+		}
+
+		size_t Len = MIN_MATCH;
+		while (Ip + Len < Size && Src[Candidate + Len] == Src[Ip + Len])
+			Len++;
+
+		if(!WriteSequence(Op, OEnd, Src + Anchor, Ip - Anchor, Ip - Candidate, Len))
+			return 0;
+
+		Ip += Len;
+		Anchor = Ip;
+	}
+
+	if(!WriteSequence(Op, OEnd, Src + Anchor, Size - Anchor, 0, 0))
+		return 0;
+
+	return Op - Dst;
+}
+
+//Returns the decompressed size or -1, if the input is malformed or doesn't fit into Dst.
+inline ptrdiff_t Decompress(const char *Src, size_t Size, char *Dst, size_t Capacity)
+{
+	using namespace Internal;
+
+	const char *Ip = Src;
+	const char *IEnd = Src + Size;
+	char *Op = Dst;
+	char *OEnd = Dst + Capacity;
+
+	while (Ip < IEnd)
+	{
+		uint8_t Token = (uint8_t)*Ip++;
+
+		size_t LitLen = Token >> 4;
+		if(LitLen == 15 && !ReadLength(Ip, IEnd, LitLen))
+			return -1;
+
+		if((size_t)(IEnd - Ip) < LitLen || (size_t)(OEnd - Op) < LitLen)
+			return -1;
+
+		memcpy(Op, Ip, LitLen);
+		Ip += LitLen;
+		Op += LitLen;
+
+		if(Ip == IEnd)  //Last sequence.
+			break;
+
+		if(IEnd - Ip < 2)
+			return -1;
+
+		size_t Offset = (uint8_t)Ip[0] | ((size_t)(uint8_t)Ip[1] << 8);
+		Ip += 2;
+
+		size_t MatchLen = Token & 15;
+		if(MatchLen == 15 && !ReadLength(Ip, IEnd, MatchLen))
+			return -1;
+
+		MatchLen += MIN_MATCH;
+		if(Offset == 0 || Offset > (size_t)(Op - Dst) || (size_t)(OEnd - Op) < MatchLen)
+			return -1;
+
+		const char *Match = Op - Offset;
+		if(Offset >= MatchLen)
+			memcpy(Op, Match, MatchLen);
+		else
+		{
+			for (size_t i = 0; i < MatchLen; i++)  //Overlapping copy repeats the pattern.
+				Op[i] = Match[i];
+		}
+
+		Op += MatchLen;
+	}
+
+	return Op - Dst;
+}
+
+} // namespace Assets::LZ
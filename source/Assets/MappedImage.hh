@@ -0,0 +1,131 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <algorithm>
+
+#ifdef _WIN32
+#	ifndef WIN32_LEAN_AND_MEAN
+#		define WIN32_LEAN_AND_MEAN
+#	endif
+#	ifndef NOMINMAX
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+namespace Assets {
+
+//Read only memory mapping of a whole host file.
+class CMappedImage
+{
+	public:
+		CMappedImage(const std::string &Path)
+		{
+#ifdef _WIN32
+			m_File = CreateFileA(Path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if(m_File == INVALID_HANDLE_VALUE)
+				return;
+
+			LARGE_INTEGER Size;
+			if(!GetFileSizeEx(m_File, &Size) || Size.QuadPart == 0)
+				return;
+
+			m_Mapping = CreateFileMappingA(m_File, NULL, PAGE_READONLY, 0, 0, NULL);
+			if(!m_Mapping)
+				return;
+
+			m_Data = (const char*)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+			if(m_Data)
+				m_Size = (size_t)Size.QuadPart;
+#else
+			int Fd = open(Path.c_str(), O_RDONLY);
+			if(Fd < 0)
+				return;
+
+			struct stat St;
+			if(fstat(Fd, &St) == 0 && St.st_size > 0)
+			{
+				void *Ptr = mmap(nullptr, St.st_size, PROT_READ, MAP_SHARED, Fd, 0);
+				if(Ptr != MAP_FAILED)
+				{
+					m_Data = (const char*)Ptr;
+					m_Size = (size_t)St.st_size;
+				}
+			}
+
+			close(Fd);  //The mapping stays valid without the descriptor.
+#endif
+		}
+
+		CMappedImage(const CMappedImage&) = delete;
+		CMappedImage &operator=(const CMappedImage&) = delete;
+
+		inline bool IsOpen() const
+		{
+			return m_Data != nullptr;
+		}
+
+		inline const char *Data() const
+		{
+			return m_Data;
+		}
+
+		inline size_t Size() const
+		{
+			return m_Size;
+		}
+
+		//Asks the OS to read the range into the page cache in the background. Only a hint, errors are ignored.
+		void Prefetch(size_t Offset, size_t Size) const
+		{
+			if(Offset >= m_Size)
+				return;
+
+			Size = std::min(Size, m_Size - Offset);
+#ifdef _WIN32
+#	if _WIN32_WINNT >= 0x0602
+			WIN32_MEMORY_RANGE_ENTRY Range{(PVOID)(m_Data + Offset), Size};
+			PrefetchVirtualMemory(GetCurrentProcess(), 1, &Range, 0);
+#	endif
+#else
+			//madvise needs a page aligned address.
+			size_t Page = (size_t)sysconf(_SC_PAGESIZE);
+			size_t Begin = Offset - Offset % Page;
+			madvise((void*)(m_Data + Begin), Size + (Offset - Begin), MADV_WILLNEED);
+#endif
+		}
+
+		~CMappedImage()
+		{
+#ifdef _WIN32
+			if(m_Data)
+				UnmapViewOfFile(m_Data);
+
+			if(m_Mapping)
+				CloseHandle(m_Mapping);
+
+			if(m_File != INVALID_HANDLE_VALUE)
+				CloseHandle(m_File);
+#else
+			if(m_Data)
+				munmap((void*)m_Data, m_Size);
+#endif
+		}
+
+	private:
+		const char *m_Data = nullptr;
+		size_t m_Size = 0;
+
+#ifdef _WIN32
+		HANDLE m_File = INVALID_HANDLE_VALUE;
+		HANDLE m_Mapping = NULL;
+#endif
+};
+
+} // namespace Assets
@@ -0,0 +1,280 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iterator>
+#include <cstdint>
+#include <string.h>
+
+#include "VFS.hh"
+
+namespace Assets {
+
+//Handle of a node inside a CVFSNodeTable, the index of its slot.
+struct SNodeHandle
+{
+	static constexpr uint32_t INVALID = 0xFFFFFFFF;
+
+	uint32_t Value = INVALID;
+
+	inline uint32_t Index() const
+	{
+		return Value;
+	}
+
+	inline explicit operator bool() const
+	{
+		return Value != INVALID;
+	}
+
+	bool operator==(const SNodeHandle &Other) const
+	{
+		return Value == Other.Value;
+	}
+
+	bool operator!=(const SNodeHandle &Other) const
+	{
+		return Value != Other.Value;
+	}
+};
+
+//Read only snapshot of the node metadata of a CVFS, stored column wise in flat arrays, the names live in one string pool.
+//Walks only touch the columns they need and listing a directory follows the sibling links without allocating.
+//The table holds no file data and isn't updated by the filesystem: changes made after the snapshot aren't seen,
+//so it pays off for repeated walks over a tree, which stays the same (e.g. a mounted image). Building it costs
+//a bit more than one List() walk of the filesystem itself, see development/bench/TreeWalk.cc.
+//Like the standard containers, the table isn't synchronized.
+class CVFSNodeTable
+{
+	public:
+		static constexpr uint8_t FLAG_DIR = 1;
+
+		//Iterates the childs of a directory in the order of CVFSDir::GetChilds().
+		class CChildIterator
+		{
+			public:
+				using iterator_category = std::forward_iterator_tag;
+				using value_type = SNodeHandle;
+				using difference_type = std::ptrdiff_t;
+				using pointer = const SNodeHandle*;
+				using reference = SNodeHandle;
+
+				CChildIterator() = default;
+				CChildIterator(const CVFSNodeTable *Table, uint32_t Index) : m_Table(Table), m_Index(Index) {}
+
+				inline SNodeHandle operator*() const
+				{
+					return SNodeHandle{m_Index};
+				}
+
+				inline CChildIterator &operator++()
+				{
+					m_Index = m_Table->m_NextSibling[m_Index];
+					return *this;
+				}
+
+				inline CChildIterator operator++(int)
+				{
+					auto Ret = *this;
+					++*this;
+					return Ret;
+				}
+
+				bool operator==(const CChildIterator &Other) const
+				{
+					return m_Index == Other.m_Index;
+				}
+
+				bool operator!=(const CChildIterator &Other) const
+				{
+					return m_Index != Other.m_Index;
+				}
+
+			private:
+				const CVFSNodeTable *m_Table = nullptr;
+				uint32_t m_Index = NONE;
+		};
+
+		struct SChildRange
+		{
+			CChildIterator First;
+			CChildIterator Last;
+
+			inline CChildIterator begin() const
+			{
+				return First;
+			}
+
+			inline CChildIterator end() const
+			{
+				return Last;
+			}
+		};
+
+		//Copies the metadata of the tree, concurrent changes of the filesystem may or may not be seen.
+		explicit CVFSNodeTable(CVFS &Vfs)
+		{
+			AddSlot("/", NONE, FLAG_DIR, 0);
+
+			std::vector<std::pair<uint32_t, CVFS::VFSDir>> Stack{{0, Vfs.m_Root}};
+			while (!Stack.empty())
+			{
+				auto [Dir, Node] = std::move(Stack.back());
+				Stack.pop_back();
+
+				//The childs of a directory have unique names, so the table takes them without checking.
+				for (auto &&e : Node->GetChilds())
+				{
+					std::string Name = e->Name();
+					uint32_t Index = AddSlot(Name, Dir, e->IsDir() ? FLAG_DIR : 0, e->IsDir() ? 0 : std::static_pointer_cast<CVFS::CVFSFile>(e)->Size());
+					Link(Dir, Index);
+					if(e->IsDir())
+						Stack.emplace_back(Index, std::static_pointer_cast<CVFS::CVFSDir>(e));
+				}
+			}
+		}
+
+		inline SNodeHandle Root() const
+		{
+			return SNodeHandle{0};
+		}
+
+		//Returns true, if the handle points to a node of this table.
+		inline bool Valid(SNodeHandle Node) const
+		{
+			return Node.Index() < m_Flags.size();
+		}
+
+		inline size_t Count() const
+		{
+			return m_Flags.size();
+		}
+
+		inline std::string_view Name(SNodeHandle Node) const
+		{
+			uint32_t Index = Check(Node);
+			return std::string_view(m_Names.data() + m_NameOffset[Index], m_NameSize[Index]);
+		}
+
+		inline bool IsDir(SNodeHandle Node) const
+		{
+			return m_Flags[Check(Node)] & FLAG_DIR;
+		}
+
+		//Size of the file at the time of the snapshot, directories are 0.
+		inline uint64_t Size(SNodeHandle Node) const
+		{
+			return m_Size[Check(Node)];
+		}
+
+		//Returns an invalid handle for the root.
+		inline SNodeHandle Parent(SNodeHandle Node) const
+		{
+			return SNodeHandle{m_Parent[Check(Node)]};
+		}
+
+		inline SChildRange Childs(SNodeHandle Dir) const
+		{
+			return SChildRange{CChildIterator(this, m_FirstChild[CheckDir(Dir)]), CChildIterator(this, NONE)};
+		}
+
+		//Returns the child with the given name or an invalid handle.
+		SNodeHandle Find(SNodeHandle Dir, std::string_view Name) const
+		{
+			return SNodeHandle{FindIndex(CheckDir(Dir), Name)};
+		}
+
+		//Resolves an absolute or relative path like CVFS::GetNodeInfo(), returns an invalid handle if a part is missing.
+		SNodeHandle Resolve(std::string_view Path, SNodeHandle Dir = SNodeHandle()) const
+		{
+			uint32_t Index = Dir ? Check(Dir) : 0;
+			while (!Path.empty())
+			{
+				size_t Pos = Path.find('/');
+				std::string_view Part = Path.substr(0, Pos);
+				Path = Pos == std::string_view::npos ? std::string_view() : Path.substr(Pos + 1);
+				if(Part.empty() || Part == ".")
+					continue;
+
+				if(Part == "..")
+					Index = m_Parent[Index] == NONE ? Index : m_Parent[Index];
+				else if(!(m_Flags[Index] & FLAG_DIR) || (Index = FindIndex(Index, Part)) == NONE)
+					return SNodeHandle();
+			}
+
+			return SNodeHandle{Index};
+		}
+
+	private:
+		static constexpr uint32_t NONE = SNodeHandle::INVALID;
+
+		inline uint32_t Check(SNodeHandle Node) const
+		{
+			if(!Valid(Node))
+				throw CVFSException("Invalid node handle.", VFSError::NODE_DOESNT_EXISTS);
+
+			return Node.Index();
+		}
+
+		inline uint32_t CheckDir(SNodeHandle Node) const
+		{
+			uint32_t Index = Check(Node);
+			if(!(m_Flags[Index] & FLAG_DIR))
+				throw CVFSException("Node is a file.", VFSError::NODE_IS_FILE);
+
+			return Index;
+		}
+
+		uint32_t FindIndex(uint32_t Dir, std::string_view Name) const
+		{
+			for (uint32_t c = m_FirstChild[Dir]; c != NONE; c = m_NextSibling[c])
+			{
+				if(m_NameSize[c] == Name.size() && memcmp(m_Names.data() + m_NameOffset[c], Name.data(), Name.size()) == 0)
+					return c;
+			}
+
+			return NONE;
+		}
+
+		uint32_t AddSlot(std::string_view Name, uint32_t Parent, uint8_t Flags, uint64_t Size)
+		{
+			if(m_Flags.size() >= NONE)
+				throw CVFSException("Can't create node table. Too many nodes.", VFSError::OUT_OF_MEM);
+
+			uint32_t Index = m_Flags.size();
+			m_NameOffset.push_back(m_Names.size());
+			m_NameSize.push_back(Name.size());
+			m_Names.insert(m_Names.end(), Name.begin(), Name.end());
+			m_Parent.push_back(Parent);
+			m_FirstChild.push_back(NONE);
+			m_LastChild.push_back(NONE);
+			m_NextSibling.push_back(NONE);
+			m_Size.push_back(Size);
+			m_Flags.push_back(Flags);
+			return Index;
+		}
+
+		void Link(uint32_t Dir, uint32_t Index)
+		{
+			if(m_LastChild[Dir] != NONE)
+				m_NextSibling[m_LastChild[Dir]] = Index;
+			else
+				m_FirstChild[Dir] = Index;
+
+			m_LastChild[Dir] = Index;
+		}
+
+		std::vector<uint32_t> m_NameOffset;
+		std::vector<uint32_t> m_NameSize;
+		std::vector<uint32_t> m_Parent;
+		std::vector<uint32_t> m_FirstChild;
+		std::vector<uint32_t> m_LastChild;
+		std::vector<uint32_t> m_NextSibling;
+		std::vector<uint64_t> m_Size;
+		std::vector<uint8_t> m_Flags;
+
+		std::vector<char> m_Names;
+};
+
+} // namespace Assets
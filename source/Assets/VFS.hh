@@ -1,13 +1,41 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <span>
 #include <chrono>
 #include <vector>
 #include <memory>
 #include <stdexcept>
 #include <algorithm>
+#include <iterator>
 #include <string.h>
 #include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+#include <list>
+#include <ranges>
+#include <filesystem>
+#include <functional>
+#include <ostream>
+#include <climits>
+#include <cstdint>
+#include <cerrno>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "MappedImage.hh"
+#include "LZ.hh"
+#include "Hash.hh"
+#include "HostFile.hh"
+#include "ZipArchive.hh"
+#include "Misc/Threads/ThreadPool.hh"
 
 namespace Assets {
 
@@ -16,6 +44,8 @@ namespace Assets {
 class CVFS;
 class CVFSNode;
 class CVFSFileStream;
+class CVFSSnapshot;
+class CVFSNodeTable;
 
 using VFSNode = std::shared_ptr<CVFSNode>;
 using VFSFileStream = std::shared_ptr<CVFSFileStream>;
@@ -31,7 +61,9 @@ enum class VFSError
 	NODE_ALREADY_EXISTS,
 	NODE_DOESNT_EXISTS,
 	FAILED_TO_READ_STREAM,
-	CANT_CREATE_FILESYSTEM
+	FAILED_TO_WRITE_STREAM,
+	CANT_CREATE_FILESYSTEM,
+	IO_CANCELLED
 };
 
 enum class FileMode
@@ -93,788 +125,3513 @@ class CVFSException : public std::exception
 		VFSError m_ErrType;
 };
 
-class CVFSNode
+//Hands out CHUNK_SIZE blocks carved from larger slabs. Freed blocks are kept in an intrusive free list
+//and reused, slabs are released together with the pool.
+class CVFSChunkPool
 {
-	friend CVFS;
-
 	public:
-		CVFSNode()
-		{
-			m_Created = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-			m_Accessed = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-		}
-
-		CVFSNode(const CVFSNode &node)
+		char *Alloc()
 		{
-			m_Name = node.m_Name;
-			m_IsDir = node.m_IsDir;
+			std::lock_guard<std::mutex> lock(m_Lock);
+			if(!m_FreeList)
+				Grow();
 
-			m_Created = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-			m_Accessed = node.m_Accessed;
+			char *Ret = m_FreeList;
+			m_FreeList = *(char**)Ret;
+			m_InUse++;
+			return Ret;
 		}
 
-		inline std::string Name() const
+		void Free(char *Data)
 		{
-			std::lock_guard<std::mutex> lock(m_UpdateLock);
-			return m_Name;
+			std::lock_guard<std::mutex> lock(m_Lock);
+			*(char**)Data = m_FreeList;
+			m_FreeList = Data;
+			m_InUse--;
 		}
 
-		inline bool IsDir() const
+		//Number of handed out chunks.
+		size_t InUse() const
 		{
-			std::lock_guard<std::mutex> lock(m_UpdateLock);
-			return m_IsDir;
+			std::lock_guard<std::mutex> lock(m_Lock);
+			return m_InUse;
 		}
 
-		inline time_t Created() const
-		{
-			std::lock_guard<std::mutex> lock(m_UpdateLock);
-			return m_Created;
-		}
-		
-		inline time_t Accessed() const
+		//Pool for files, which don't belong to a filesystem.
+		static std::shared_ptr<CVFSChunkPool> Default()
 		{
-			std::lock_guard<std::mutex> lock(m_UpdateLock);
-			return m_Accessed;
+			static std::shared_ptr<CVFSChunkPool> Pool = std::make_shared<CVFSChunkPool>();
+			return Pool;
 		}
 
-		virtual VFSNode Copy() = 0;
-
-		virtual ~CVFSNode() = default;
+	private:
+		static constexpr size_t SLAB_CHUNKS = 64;
 
-	protected:
-		std::string m_Name;
-		bool m_IsDir;
+		void Grow()
+		{
+			try
+			{
+				m_Slabs.emplace_back(new char[SLAB_CHUNKS * CHUNK_SIZE]);
+			}
+			catch(const std::bad_alloc &e)
+			{
+				throw CVFSException("Can't allocate chunk. Out of mem. bad_alloc: " + std::string(e.what()), VFSError::OUT_OF_MEM);
+			}
 
-		time_t m_Created;
-		time_t m_Accessed;
+			char *Slab = m_Slabs.back().get();
+			for (size_t i = SLAB_CHUNKS; i-- > 0;)
+			{
+				*(char**)(Slab + i * CHUNK_SIZE) = m_FreeList;
+				m_FreeList = Slab + i * CHUNK_SIZE;
+			}
+		}
 
-		mutable std::mutex m_UpdateLock;
+		std::vector<std::unique_ptr<char[]>> m_Slabs;
+		char *m_FreeList = nullptr;
+		size_t m_InUse = 0;
+		mutable std::mutex m_Lock;
 };
 
-class CVFS
+//Buffers the output of the serializer and passes it in large blocks to the sink.
+//Blocks bigger than the buffer are passed directly.
+class CVFSWriter
 {
-	friend CVFSFileStream;
-
 	public:
-		CVFS(/* args */) 
-		{
-			m_Root = VFSDir(new CVFSDir("/"));
-		}
+		using Sink = std::function<void(const char*, size_t)>;
 
-		void CreateDir(const std::string &Path, bool Force = false)
+		CVFSWriter(Sink Out, size_t BufSize = 64 * 1024) : m_Out(Out), m_Buf(new char[BufSize]), m_BufSize(BufSize), m_Filled(0), m_Written(0) {}
+
+		void Write(const void *Data, size_t Size)
 		{
-			auto Dirs = SplitPath(Path);
-			auto CurDir = m_Root;
+			if(Size == 0)   //Data may be null then, e.g. for an empty vector.
+				return;
 
-			for (size_t i = 0; i < Dirs.size(); i++)
-			{
-				std::string Dir = Dirs[i];
+			if(m_Filled + Size > m_BufSize)
+				Flush();
 
-				auto node = CurDir->Search(Dir);
+			if(Size >= m_BufSize)
+				m_Out((const char*)Data, Size);
+			else
+			{
+				memcpy(m_Buf.get() + m_Filled, Data, Size);
+				m_Filled += Size;
+			}
 
-				if(!node && (Force || (i == Dirs.size() - 1)))
-				{
-					VFSDir tmp;
-					try
-					{
-						tmp = VFSDir(new CVFSDir(Dir));
-						CurDir->AppendChild(tmp);
-					}
-					catch(const std::bad_alloc &e)
-					{
-						throw CVFSException("Can't create directory. Out of mem. bad_alloc: " + std::string(e.what()), VFSError::OUT_OF_MEM);
-					}
-					
-					CurDir = tmp;
-				}
-				else if(!node || !node->IsDir())
-					throw CVFSException("Can't create directory", VFSError::CANT_CREATE_DIR);
-				else
-					CurDir = std::static_pointer_cast<CVFSDir>(node);
-			}               
+			m_Written += Size;
 		}
 
-		VFSNode GetNodeInfo(const std::string &Path)
+		//Writes Count zero bytes.
+		void Fill(size_t Count)
 		{
-			auto Dirs = SplitPath(Path);
-			auto CurDir = m_Root;
-			VFSNode Ret;
-			if(Path == "/")
-				Ret = m_Root;
-
-			for (size_t i = 0; i < Dirs.size(); i++)
+			m_Written += Count;
+			while (Count != 0)
 			{
-				std::string Dir = Dirs[i];
+				if(m_Filled == m_BufSize)
+					Flush();
 
-				auto node = CurDir->Search(Dir);
-				if(node && (node->IsDir() || (i == Dirs.size() - 1)))   //"Go into" the directory. 
-				{
-					Ret = node;
-					CurDir = std::static_pointer_cast<CVFSDir>(node);
-				}
-				else
-				{
-					Ret = nullptr;
-					break;
-				}
+				size_t Part = std::min(Count, m_BufSize - m_Filled);
+				memset(m_Buf.get() + m_Filled, 0, Part);
+				m_Filled += Part;
+				Count -= Part;
 			}
+		}
 
-			return Ret;
+		void Flush()
+		{
+			if(m_Filled != 0)
+				m_Out(m_Buf.get(), m_Filled);
+
+			m_Filled = 0;
 		}
 
-		bool NodeExists(const std::string &Path)
+		inline uint64_t Tell() const
 		{
-			return GetNodeInfo(Path) != nullptr; 
+			return m_Written;
 		}
 
-		std::vector<VFSNode> List(const std::string &Path)
+	private:
+		Sink m_Out;
+		std::unique_ptr<char[]> m_Buf;
+		size_t m_BufSize;
+		size_t m_Filled;
+		uint64_t m_Written;
+};
+
+//Read only view of file data as a list of segments, which point directly into the chunks of a file
+//or into a mapped image. The view keeps this memory alive, later writes to the file don't change it.
+class CVFSView
+{
+	public:
+		using Segment = std::span<const char>;
+
+		inline const std::vector<Segment> &Segments() const
 		{
-			auto node = GetNodeInfo(Path);
-			return List(node);
+			return m_Segments;
 		}
 
-		std::vector<VFSNode> List(VFSNode node)
+		inline std::vector<Segment>::const_iterator begin() const
 		{
-			std::vector<VFSNode> Ret;
-			if(node && node->IsDir())
-			{
-				auto Dir = std::static_pointer_cast<CVFSDir>(node);
-				Ret = Dir->GetChilds();
-			}
-			else if(node && !node->IsDir())
-				throw CVFSException("Given node is not a directory", VFSError::NODE_IS_FILE);
+			return m_Segments.begin();
+		}
 
-			return Ret;
+		inline std::vector<Segment>::const_iterator end() const
+		{
+			return m_Segments.end();
+		}
+
+		inline size_t Size() const
+		{
+			return m_Size;
 		}
 
-		VFSFileStream Open(const std::string &Path, FileMode mode);
+		inline bool Empty() const
+		{
+			return m_Size == 0;
+		}
 
-		size_t FileSize(VFSNode node)
+		//Returns the data as one block, the data is only copied if the view has more than one segment.
+		std::span<const char> Contiguous()
 		{
-			if(!node->IsDir())
+			if(m_Segments.size() > 1)
 			{
-				auto file = std::static_pointer_cast<CVFSFile>(node);
-				return file->Size();
+				auto Buf = std::make_shared<std::vector<char>>();
+				Buf->reserve(m_Size);
+				for (auto &&e : m_Segments)
+					Buf->insert(Buf->end(), e.begin(), e.end());
+
+				m_Segments.assign(1, Segment(Buf->data(), Buf->size()));
+				m_Owners.assign(1, Buf);
 			}
-			else if(node && !node->IsDir())
-				throw CVFSException("Given node is not a file.", VFSError::NODE_IS_DIR);
 
-			return 0;
+			return m_Segments.empty() ? Segment() : m_Segments[0];
 		}
 
-		void Rename(const std::string &Path, const std::string &Name)
+		//Returns an owner of the viewed memory, for consumers which outlive the view.
+		std::shared_ptr<const void> Pin() const
 		{
-			if(NodeExists(Path))
-			{
-				if(!NodeExists(ExtractPath(Path) + "/" + Name))
-				{
-					auto Parent = std::static_pointer_cast<CVFSDir>(GetNodeInfo(ExtractPath(Path)));
-					Parent->RenameChild(ExtractName(Path), Name);
-				}
-				else
-					throw CVFSException("Can't rename node. Node already exists.", VFSError::NODE_ALREADY_EXISTS);
-			}
-			else
-				throw CVFSException("Can't rename node. Node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+			return std::make_shared<const CVFSView>(*this);
 		}
 
-		void Move(const std::string &From, const std::string &To)
+		void Append(const char *Data, size_t Size, std::shared_ptr<const void> Owner)
 		{
-			if(!NodeExists(From))
-				throw CVFSException("Can't move node. Source node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+			if(Size == 0)
+				return;
 
-			if(!NodeExists(To))
-				throw CVFSException("Can't move node. Destination node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+			m_Segments.emplace_back(Data, Size);
+			m_Size += Size;
+			if(m_Owners.empty() || m_Owners.back() != Owner)
+				m_Owners.push_back(std::move(Owner));
+		}
 
-			auto DestNode = GetNodeInfo(To);
-			if(!DestNode->IsDir())
-				throw CVFSException("Can't move node. Destination node is a file.", VFSError::NODE_IS_FILE);
+	private:
+		std::vector<Segment> m_Segments;
+		std::vector<std::shared_ptr<const void>> m_Owners;
+		size_t m_Size = 0;
+};
 
-			auto node = GetNodeInfo(From);
-			auto SrcParent = std::static_pointer_cast<CVFSDir>(GetNodeInfo(ExtractPath(From)));
-			auto DestParent = std::static_pointer_cast<CVFSDir>(DestNode);
+//Read only data source of a file, which wasn't modified yet (e.g. a region of a mapped disk image).
+//The file copies the data into its own chunks on the first write.
+class IVFSBacking
+{
+	public:
+		virtual size_t Read(char *Buf, size_t Size, size_t Pos) const = 0;
 
-			SrcParent->RemoveChild(node->Name());
-			DestParent->AppendChild(node);
-		}
+		//Calls Func for every continuous part of the data.
+		virtual void ForEachSegment(const std::function<void(const char*, size_t)> &Func) const = 0;
 
-		void Delete(const std::string &Path)
+		//Appends the data in [Pos, Pos + Size) to Out without copying, where the source allows it.
+		virtual void View(size_t Pos, size_t Size, CVFSView &Out) const = 0;
+
+		virtual ~IVFSBacking() = default;
+};
+
+//File data, which lives inside a mapped disk image.
+class CVFSMappedRegion : public IVFSBacking
+{
+	public:
+		CVFSMappedRegion(std::shared_ptr<const CMappedImage> Image, const char *Data, size_t Size) : m_Image(Image), m_Data(Data), m_Size(Size) {}
+
+		size_t Read(char *Buf, size_t Size, size_t Pos) const override
 		{
-			if(!NodeExists(Path))
-				throw CVFSException("Can't delete node. Node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+			size_t CopyCount = Pos < m_Size ? std::min(Size, m_Size - Pos) : 0;
+			if(CopyCount != 0)
+				memcpy(Buf, m_Data + Pos, CopyCount);
 
-			auto node = GetNodeInfo(Path);
-			auto Parent = std::static_pointer_cast<CVFSDir>(GetNodeInfo(ExtractPath(Path)));
+			return CopyCount;
+		}
 
-			Parent->RemoveChild(node->Name());
+		void ForEachSegment(const std::function<void(const char*, size_t)> &Func) const override
+		{
+			if(m_Size != 0)
+				Func(m_Data, m_Size);
 		}
 
-		void Copy(const std::string &From, const std::string &To)
+		void View(size_t Pos, size_t Size, CVFSView &Out) const override
 		{
-			if(!NodeExists(From))
-				throw CVFSException("Can't copy node. Source node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+			if(Pos < m_Size)
+				Out.Append(m_Data + Pos, std::min(Size, m_Size - Pos), m_Image);
+		}
 
-			if(NodeExists(To))
-				throw CVFSException("Can't copy node. Destination node already exists.", VFSError::NODE_ALREADY_EXISTS);
+	private:
+		std::shared_ptr<const CMappedImage> m_Image;
+		const char *m_Data;
+		size_t m_Size;
+};
 
-			auto DestNode = GetNodeInfo(ExtractPath(To));
-			if(!DestNode->IsDir())
-				throw CVFSException("Can't copy node. Destination node parent is a file.", VFSError::NODE_IS_FILE);
+struct SVFSOptions
+{
+	bool NoAtime = false;	//Reading files and listing directories doesn't update the access time.
+	size_t CacheSize = 64 * 1024 * 1024;	//Bytes of lazily loaded file contents (host and zip mounts) kept in memory.
+	bool Dedup = false;	//Files with identical chunks share them, see CVFS::CVFSChunkStore.
+	bool Readahead = true;	//Mounting a packed image prefetches the blocks of its startup files, see SVFSPackOptions::AccessOrder.
+};
 
-			auto node = GetNodeInfo(From);
-			auto DestParent = std::static_pointer_cast<CVFSDir>(DestNode);
+struct SVFSStats
+{
+	size_t ChunkMemory = 0;	//Bytes of chunk storage in use.
+	uint64_t DedupedChunks = 0;	//Chunks, which were replaced by an identical shared chunk.
+};
 
-			auto copy = node->Copy();
-			copy->m_Name = ExtractName(To);
+struct SVFSPackOptions
+{
+	uint32_t BlockSize = 64 * 1024;	//Uncompressed size of a block.
+	bool Dedup = true;				//Identical blocks are stored once.
+	unsigned Threads = 0;			//Threads compressing blocks, 0 uses the whole global pool.
+	std::vector<std::string> AccessOrder;	//Files stored first in this order, e.g. recorded by CVFS::StopAccessLog().
+};
 
-			DestParent->AppendChild(copy);
-		}
+//Metadata of a node visited by CVFS::Walk() or CVFS::Glob().
+struct SVFSEntry
+{
+	std::string Path;	//Relative to the walked directory (the root for globs), without leading slash.
+	VFSNode Node;
+	uint32_t Depth;		//1 for the childs of the walked directory.
+	bool IsDir;
+	uint64_t Size;		//0 for directories.
+	time_t Created;
+	time_t Modified;	//Creation time for directories.
+
+	inline std::string_view Name() const
+	{
+		size_t Pos = Path.rfind('/');
+		return std::string_view(Path).substr(Pos == std::string::npos ? 0 : Pos + 1);
+	}
+};
 
-		std::vector<char> Serialize()
-		{
-			try
-			{
-				VFSFile Disk = VFSFile(new CVFSFile("stream"));
-				Disk->Clear();
-				Disk->Write(MAGIC.data(), MAGIC.size());
+struct SVFSWalkOptions
+{
+	size_t BatchSize = 256;	//Entries passed to one call of the visitor.
+	unsigned Threads = 1;	//Threads walking subtrees, 0 uses the whole global pool.
+	uint32_t MaxDepth = 0;	//Deepest level visited, 0 for no limit.
+};
 
-				uint64_t Entries = m_Root->GetChilds().size();
-				Disk->Write((char*)&Entries, sizeof(Entries));
-				FillSpace(Disk.get(), DISK_CHUNK_SIZE - (MAGIC.size() + sizeof(Entries)));
+//Entry of the block index of a packed image.
+struct SVFSBlockEntry
+{
+	static constexpr uint32_t COMPRESSED = 1;
 
-				auto Childs = m_Root->GetChilds();
-				for (auto e : Childs)
-					SerializeNode(Disk.get(), e.get());
+	uint64_t Offset;
+	uint32_t StoredSize;
+	uint32_t RawSize;
+	uint32_t Flags;
+	uint32_t Reserved;
+};
 
-				std::vector<char> Ret;
-				Ret.resize(Disk->Size());
-				Disk->Read(&Ret[0], Disk->Size(), 0);
-				return Ret;
-			}
-			catch(const std::bad_alloc &e)
-			{
-				throw CVFSException("Can't create stream. Out of mem. bad_alloc: " + std::string(e.what()), VFSError::OUT_OF_MEM);
-			}
-		}
+//File data, which is stored in the blocks of a mapped packed image.
+//Only the blocks touched by a read are decompressed, the last partially read block is cached.
+class CVFSBlockRegion : public IVFSBacking
+{
+	public:
+		CVFSBlockRegion(std::shared_ptr<const CMappedImage> Image, std::shared_ptr<const std::vector<SVFSBlockEntry>> Blocks, std::vector<uint64_t> &&Ids, size_t Size, uint32_t BlockSize)
+			: m_Image(Image), m_Blocks(Blocks), m_Ids(std::move(Ids)), m_Size(Size), m_BlockSize(BlockSize) {}
 
-		void Deserialize(const std::vector<char> &Data)
+		size_t Read(char *Buf, size_t Size, size_t Pos) const override
 		{
-			try
+			size_t Readed = 0;
+			Size = Pos < m_Size ? std::min(Size, m_Size - Pos) : 0;
+
+			while (Readed < Size)
 			{
-				size_t Pos = 0;
-				uint64_t Entries = 0;
-				std::string FileMagic;
-				FileMagic.resize(MAGIC.size());
+				size_t Block = (Pos + Readed) / m_BlockSize;
+				size_t Offset = (Pos + Readed) % m_BlockSize;
+				const SVFSBlockEntry &Entry = (*m_Blocks)[m_Ids[Block]];
+				size_t CopyCount = std::min(Size - Readed, (size_t)Entry.RawSize - Offset);
+
+				if(!(Entry.Flags & SVFSBlockEntry::COMPRESSED))
+					memcpy(Buf + Readed, m_Image->Data() + Entry.Offset + Offset, CopyCount);
+				else if(CopyCount == Entry.RawSize) //Whole blocks are decompressed in place.
+					Decode(m_Image->Data(), Entry, Buf + Readed);
+				else
+				{
+					//Concurrent readers don't wait for the cache, they decode into their own buffer instead.
+					std::unique_lock<std::mutex> lock(m_CacheLock, std::try_to_lock);
+					if(!lock.owns_lock())
+					{
+						thread_local std::vector<char> Scratch;
+						Scratch.resize(m_BlockSize);
+						Decode(m_Image->Data(), Entry, Scratch.data());
+						memcpy(Buf + Readed, Scratch.data() + Offset, CopyCount);
+					}
+					else
+					{
+						if(m_CachedBlock != Block)
+						{
+							m_Cache.resize(m_BlockSize);
+							m_CachedBlock = (size_t)-1;
+							Decode(m_Image->Data(), Entry, m_Cache.data());
+							m_CachedBlock = Block;
+						}
 
-				ReadVector(Data, &FileMagic[0], FileMagic.size(), Pos);
-				if(FileMagic != MAGIC)
-					throw CVFSException("Can't create filesystem.", VFSError::CANT_CREATE_FILESYSTEM);
+						memcpy(Buf + Readed, m_Cache.data() + Offset, CopyCount);
+					}
+				}
 
-				ReadVector(Data, (char*)&Entries, sizeof(Entries), Pos);
+				Readed += CopyCount;
+			}
 
-				Pos += (DISK_CHUNK_SIZE - (MAGIC.size() + sizeof(Entries)));
+			return Readed;
+		}
 
-				for (size_t i = 0; i < Entries; i++)
-					m_Root->AppendChild(DeserializeNode(Data, Pos));
-			
-			}
-			catch(const std::bad_alloc &e)
+		void ForEachSegment(const std::function<void(const char*, size_t)> &Func) const override
+		{
+			std::vector<char> Buf;
+			for (auto Id : m_Ids)
 			{
-				throw CVFSException("Can't create filesystem. Out of mem. bad_alloc: " + std::string(e.what()), VFSError::OUT_OF_MEM);
+				const SVFSBlockEntry &Entry = (*m_Blocks)[Id];
+				if(!(Entry.Flags & SVFSBlockEntry::COMPRESSED))
+					Func(m_Image->Data() + Entry.Offset, Entry.RawSize);
+				else
+				{
+					Buf.resize(Entry.RawSize);
+					Decode(m_Image->Data(), Entry, Buf.data());
+					Func(Buf.data(), Buf.size());
+				}
 			}
 		}
 
-		size_t ReadVector(const std::vector<char> &Data, char *Buf, size_t Size, size_t &Pos)
+		//Raw blocks are viewed inside the mapping, compressed blocks are decoded into a buffer owned by the view.
+		void View(size_t Pos, size_t Size, CVFSView &Out) const override
 		{
-			size_t CopyCount = (Pos + Size) < Data.size() ? Size : (Data.size() - Pos);
-			if(CopyCount > Data.size())
-			   throw CVFSException("Can't create filesystem.", VFSError::FAILED_TO_READ_STREAM);
+			Size = Pos < m_Size ? std::min(Size, m_Size - Pos) : 0;
+			for (size_t Done = 0; Done < Size;)
+			{
+				size_t Block = (Pos + Done) / m_BlockSize;
+				size_t Offset = (Pos + Done) % m_BlockSize;
+				const SVFSBlockEntry &Entry = (*m_Blocks)[m_Ids[Block]];
+				size_t Count = std::min(Size - Done, (size_t)Entry.RawSize - Offset);
 
-			memcpy(Buf, Data.data() + Pos, CopyCount);
-			Pos += CopyCount;
+				if(!(Entry.Flags & SVFSBlockEntry::COMPRESSED))
+					Out.Append(m_Image->Data() + Entry.Offset + Offset, Count, m_Image);
+				else
+				{
+					auto Buf = std::make_shared<std::vector<char>>(Entry.RawSize);
+					Decode(m_Image->Data(), Entry, Buf->data());
+					Out.Append(Buf->data() + Offset, Count, Buf);
+				}
 
-			return CopyCount;
+				Done += Count;
+			}
+		}
+
+		static void Decode(const char *Image, const SVFSBlockEntry &Entry, char *Dst)
+		{
+			if(!(Entry.Flags & SVFSBlockEntry::COMPRESSED))
+				memcpy(Dst, Image + Entry.Offset, Entry.RawSize);
+			else if(LZ::Decompress(Image + Entry.Offset, Entry.StoredSize, Dst, Entry.RawSize) != (ptrdiff_t)Entry.RawSize)
+				throw CVFSException("Can't decompress block.", VFSError::FAILED_TO_READ_STREAM);
 		}
 
-		~CVFS() {}
 	private:
-		const std::string MAGIC = "CVFS-DISK";
-		const int DISK_CHUNK_SIZE = 128;
-		const std::string NODE_IDENTIFIER = "NODE";
+		std::shared_ptr<const CMappedImage> m_Image;
+		std::shared_ptr<const std::vector<SVFSBlockEntry>> m_Blocks;
+		std::vector<uint64_t> m_Ids;
+		size_t m_Size;
+		uint32_t m_BlockSize;
+
+		mutable std::mutex m_CacheLock;
+		mutable std::vector<char> m_Cache;
+		mutable size_t m_CachedBlock = (size_t)-1;
+};
 
-		class CVFSFile;
-		class CVFSDir;
+//Size bounded LRU cache for the contents of lazily loaded files.
+//The contents are shared, so evicting an entry doesn't invalidate readers or views of it.
+class CVFSContentCache
+{
+	public:
+		using Content = std::shared_ptr<const std::vector<char>>;
 
-		using VFSFile = std::shared_ptr<CVFSFile>;
-		using VFSDir = std::shared_ptr<CVFSDir>;
-		
-		class CVFSFile : public CVFSNode
+		CVFSContentCache(size_t Capacity) : m_Capacity(Capacity) {}
+
+		inline size_t Capacity() const
 		{
-			friend CVFS;
+			return m_Capacity;
+		}
 
-			public:
-				CVFSFile() : CVFSNode()
-				{
-					m_IsDir = false;
-					m_Modified = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-					m_Size = 0;
-				}
+		size_t Used() const
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			return m_Used;
+		}
 
-				CVFSFile(const std::string &Name) : CVFSFile()
+		//Returns the cached content of Key or calls Load() to load it. Loading happens outside the lock,
+		//contents bigger than the whole cache are returned without being cached.
+		template<class F>
+		Content Get(const void *Key, F Load)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_Lock);
+				auto It = m_Index.find(Key);
+				if(It != m_Index.end())
+				{
+					m_Lru.splice(m_Lru.begin(), m_Lru, It->second);
+					return It->second->Data;
+				}
+			}
+
+			Content Ret = Load();
+
+			std::lock_guard<std::mutex> lock(m_Lock);
+			auto It = m_Index.find(Key);
+			if(It != m_Index.end()) //Loaded by another thread in the meantime.
+				return It->second->Data;
+
+			if(Ret->size() > m_Capacity)
+				return Ret;
+
+			m_Lru.push_front(SEntry{Key, Ret});
+			m_Index[Key] = m_Lru.begin();
+			m_Used += Ret->size();
+
+			while (m_Used > m_Capacity)
+			{
+				m_Used -= m_Lru.back().Data->size();
+				m_Index.erase(m_Lru.back().Key);
+				m_Lru.pop_back();
+			}
+
+			return Ret;
+		}
+
+		void Erase(const void *Key)
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			auto It = m_Index.find(Key);
+			if(It != m_Index.end())
+			{
+				m_Used -= It->second->Data->size();
+				m_Lru.erase(It->second);
+				m_Index.erase(It);
+			}
+		}
+
+	private:
+		struct SEntry
+		{
+			const void *Key;
+			Content Data;
+		};
+
+		std::list<SEntry> m_Lru;    //Most recently used first.
+		std::unordered_map<const void*, std::list<SEntry>::iterator> m_Index;
+		size_t m_Capacity;
+		size_t m_Used = 0;
+		mutable std::mutex m_Lock;
+};
+
+//File data, which is loaded on the first access and kept in a CVFSContentCache.
+class CVFSCachedRegion : public IVFSBacking
+{
+	public:
+		size_t Read(char *Buf, size_t Size, size_t Pos) const override
+		{
+			Size = Pos < m_Size ? std::min(Size, m_Size - Pos) : 0;
+			if(Size != 0)
+				memcpy(Buf, Get()->data() + Pos, Size);
+
+			return Size;
+		}
+
+		void ForEachSegment(const std::function<void(const char*, size_t)> &Func) const override
+		{
+			if(m_Size != 0)
+				Func(Get()->data(), m_Size);
+		}
+
+		void View(size_t Pos, size_t Size, CVFSView &Out) const override
+		{
+			if(Pos < m_Size)
+			{
+				auto Data = Get();
+				Out.Append(Data->data() + Pos, std::min(Size, m_Size - Pos), Data);
+			}
+		}
+
+		virtual ~CVFSCachedRegion()
+		{
+			m_Cache->Erase(this);
+		}
+
+	protected:
+		CVFSCachedRegion(size_t Size, std::shared_ptr<CVFSContentCache> Cache) : m_Size(Size), m_Cache(Cache) {}
+
+		//Loads the whole content, which has to be m_Size bytes.
+		virtual CVFSContentCache::Content Load() const = 0;
+
+		CVFSContentCache::Content Get() const
+		{
+			return m_Cache->Get(this, [this] { return Load(); });
+		}
+
+		size_t m_Size;
+		std::shared_ptr<CVFSContentCache> m_Cache;
+};
+
+//File of a mounted host directory. Files bigger than the cache are read directly from the host.
+class CVFSHostRegion : public CVFSCachedRegion
+{
+	public:
+		CVFSHostRegion(const std::string &Path, size_t Size, std::shared_ptr<CVFSContentCache> Cache) : CVFSCachedRegion(Size, Cache), m_Path(Path) {}
+
+		size_t Read(char *Buf, size_t Size, size_t Pos) const override
+		{
+			if(m_Size <= m_Cache->Capacity())
+				return CVFSCachedRegion::Read(Buf, Size, Pos);
+
+			Size = Pos < m_Size ? std::min(Size, m_Size - Pos) : 0;
+			ReadHost(Buf, Size, Pos);
+			return Size;
+		}
+
+		void ForEachSegment(const std::function<void(const char*, size_t)> &Func) const override
+		{
+			if(m_Size <= m_Cache->Capacity())
+				return CVFSCachedRegion::ForEachSegment(Func);
+
+			std::vector<char> Buf(std::min(m_Size, DIRECT_PIECE));
+			for (size_t Pos = 0; Pos < m_Size; Pos += Buf.size())
+			{
+				size_t Count = std::min(Buf.size(), m_Size - Pos);
+				ReadHost(Buf.data(), Count, Pos);
+				Func(Buf.data(), Count);
+			}
+		}
+
+		void View(size_t Pos, size_t Size, CVFSView &Out) const override
+		{
+			if(m_Size <= m_Cache->Capacity())
+				return CVFSCachedRegion::View(Pos, Size, Out);
+
+			Size = Pos < m_Size ? std::min(Size, m_Size - Pos) : 0;
+			auto Buf = std::make_shared<std::vector<char>>(Size);
+			ReadHost(Buf->data(), Size, Pos);
+			Out.Append(Buf->data(), Size, Buf);
+		}
+
+	protected:
+		CVFSContentCache::Content Load() const override
+		{
+			auto Ret = std::make_shared<std::vector<char>>(m_Size);
+			ReadHost(Ret->data(), m_Size, 0);
+			return Ret;
+		}
+
+	private:
+		static constexpr size_t DIRECT_PIECE = 1024 * 1024;
+
+		void ReadHost(char *Buf, size_t Size, size_t Pos) const
+		{
+			CHostFile File(m_Path);
+			if(!File.IsOpen())
+				throw CVFSException("Can't open file: " + m_Path, VFSError::CANT_OPEN_FILE);
+
+			if(File.ReadFullAt(Buf, Size, Pos) != (long long)Size)
+				throw CVFSException("Can't read file, it was changed on the host: " + m_Path, VFSError::FAILED_TO_READ_STREAM);
+		}
+
+		std::string m_Path;
+};
+
+//Entry of a mounted zip archive. Stored entries are read directly from the mapped archive,
+//deflated entries are inflated into the cache.
+class CVFSZipRegion : public CVFSCachedRegion
+{
+	public:
+		CVFSZipRegion(std::shared_ptr<const CZipArchive> Zip, const SZipEntry &Entry, std::shared_ptr<CVFSContentCache> Cache)
+			: CVFSCachedRegion(Entry.Size, Cache), m_Zip(Zip), m_Entry(Entry) {}
+
+		size_t Read(char *Buf, size_t Size, size_t Pos) const override
+		{
+			if(m_Entry.Method != CZipArchive::STORED)
+				return CVFSCachedRegion::Read(Buf, Size, Pos);
+
+			Size = Pos < m_Size ? std::min(Size, m_Size - Pos) : 0;
+			if(Size != 0)
+				memcpy(Buf, Stored() + Pos, Size);
+
+			return Size;
+		}
+
+		void ForEachSegment(const std::function<void(const char*, size_t)> &Func) const override
+		{
+			if(m_Entry.Method != CZipArchive::STORED)
+				return CVFSCachedRegion::ForEachSegment(Func);
+
+			if(m_Size != 0)
+				Func(Stored(), m_Size);
+		}
+
+		void View(size_t Pos, size_t Size, CVFSView &Out) const override
+		{
+			if(m_Entry.Method != CZipArchive::STORED)
+				return CVFSCachedRegion::View(Pos, Size, Out);
+
+			if(Pos < m_Size)
+				Out.Append(Stored() + Pos, std::min(Size, m_Size - Pos), m_Zip);
+		}
+
+	protected:
+		CVFSContentCache::Content Load() const override
+		{
+			auto Ret = std::make_shared<std::vector<char>>(m_Size);
+			if(!m_Zip->Extract(m_Entry, Ret->data()))
+				throw CVFSException("Can't extract zip entry: " + m_Entry.Name, VFSError::FAILED_TO_READ_STREAM);
+
+			return Ret;
+		}
+
+	private:
+		const char *Stored() const
+		{
+			const char *Ret = m_Zip->Data(m_Entry);
+			if(!Ret || m_Entry.CompressedSize != m_Entry.Size || (m_Entry.Flags & CZipArchive::ENCRYPTED))
+				throw CVFSException("Can't read zip entry: " + m_Entry.Name, VFSError::FAILED_TO_READ_STREAM);
+
+			return Ret;
+		}
+
+		std::shared_ptr<const CZipArchive> m_Zip;
+		SZipEntry m_Entry;
+};
+
+//Snapshots of one filesystem. Nodes hand their state to the snapshots taken since their last change, see CVFS::Snapshot().
+class CVFSSnapshotList
+{
+	public:
+		inline uint64_t Epoch() const
+		{
+			return m_Epoch.load(std::memory_order_acquire);
+		}
+
+		//Registers the snapshot, it sees all changes made before.
+		void Add(const std::shared_ptr<CVFSSnapshot> &Snapshot);
+
+		//Passes the state of the node to the snapshots taken after Changed. The caller holds the lock of the node.
+		void Preserve(CVFSNode *Node, uint64_t Changed);
+
+	private:
+		std::atomic<uint64_t> m_Epoch{0};
+		std::vector<std::weak_ptr<CVFSSnapshot>> m_Snapshots;
+		std::mutex m_Lock;
+};
+
+class CVFSNode : public std::enable_shared_from_this<CVFSNode>
+{
+	friend CVFS;
+
+	public:
+		CVFSNode()
+		{
+			m_Created = Now();
+			m_Accessed = Now();
+		}
+
+		CVFSNode(const CVFSNode &node) : std::enable_shared_from_this<CVFSNode>()
+		{
+			std::shared_lock<std::shared_mutex> lock(node.m_UpdateLock);
+			m_Name = node.m_Name;
+			m_IsDir = node.m_IsDir;
+			m_Snapshots = node.m_Snapshots;
+			m_Epoch = m_Snapshots ? m_Snapshots->Epoch() : 0;
+
+			m_Created = Now();
+			m_Accessed = node.m_Accessed.load();
+		}
+
+		inline std::string Name() const
+		{
+			std::shared_lock<std::shared_mutex> lock(m_UpdateLock);
+			return m_Name;
+		}
+
+		//The type of a node never changes, so no lock is needed.
+		inline bool IsDir() const
+		{
+			return m_IsDir;
+		}
+
+		inline time_t Created() const
+		{
+			return m_Created.load(std::memory_order_relaxed);
+		}
+		
+		inline time_t Accessed() const
+		{
+			return m_Accessed.load(std::memory_order_relaxed);
+		}
+
+		//Updates the access time. The store is skipped within the same second,
+		//so concurrent readers don't keep bouncing the cache line between cores.
+		inline void Touch()
+		{
+			time_t Time = Now();
+			if(m_Accessed.load(std::memory_order_relaxed) != Time)
+				m_Accessed.store(Time, std::memory_order_relaxed);
+		}
+
+		virtual VFSNode Copy() = 0;
+
+		virtual ~CVFSNode() = default;
+
+	protected:
+		static time_t Now()
+		{
+			return std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+		}
+
+		//Hands the current state to the snapshots taken since the last change. Called under the exclusive lock before every change.
+		inline void Preserve()
+		{
+			if(!m_Snapshots)
+				return;
+
+			uint64_t Epoch = m_Snapshots->Epoch();
+			if(m_Epoch != Epoch)
+			{
+				m_Snapshots->Preserve(this, m_Epoch);
+				m_Epoch = Epoch;
+			}
+		}
+
+		std::string m_Name;
+		bool m_IsDir;
+		uint64_t m_Id = 0;  //Identifies the node inside the journal, 0 if the node isn't journaled. See CVFS::Checkpoint().
+
+		std::shared_ptr<CVFSSnapshotList> m_Snapshots;
+		uint64_t m_Epoch = 0;   //Snapshot epoch of the last change.
+
+		std::atomic<time_t> m_Created;
+		std::atomic<time_t> m_Accessed;
+
+		//Readers take the lock shared, only changes of the node take it exclusive.
+		mutable std::shared_mutex m_UpdateLock;
+};
+
+class CVFS
+{
+	friend CVFSFileStream;
+	friend CVFSSnapshot;
+	friend CVFSNodeTable;
+
+	public:
+		CVFS(const SVFSOptions &Options = SVFSOptions()) : m_Options(Options), m_Pool(std::make_shared<CVFSChunkPool>()), m_Cache(std::make_shared<CVFSContentCache>(Options.CacheSize))
+		{
+			m_Snapshots = std::make_shared<CVFSSnapshotList>();
+			m_Root = NewDir("/");
+			m_Changes = std::make_shared<CVFSChangeLog>();
+			if(Options.Dedup)
+				m_Store = std::make_shared<CVFSChunkStore>();
+		}
+
+		void CreateDir(const std::string &Path, bool Force = false)
+		{
+			std::shared_lock<std::shared_mutex> TreeLock(m_TreeLock);
+			auto CurDir = m_Root;
+			std::string_view Dir;
+			size_t Pos = 0;
+
+			while (NextSegment(Path, Pos, Dir))
+			{
+				auto node = CurDir->Search(Dir);
+				bool IsLast = Pos > Path.find_last_not_of('/');
+
+				if(!node && (Force || IsLast))
+				{
+					VFSDir tmp;
+					try
+					{
+						tmp = NewDir(std::string(Dir));
+						CurDir->AppendChild(tmp);
+						RecordNode(tmp, CurDir);
+					}
+					catch(const std::bad_alloc &e)
+					{
+						throw CVFSException("Can't create directory. Out of mem. bad_alloc: " + std::string(e.what()), VFSError::OUT_OF_MEM);
+					}
+					
+					CurDir = tmp;
+				}
+				else if(!node || !node->IsDir())
+					throw CVFSException("Can't create directory", VFSError::CANT_CREATE_DIR);
+				else
+					CurDir = std::static_pointer_cast<CVFSDir>(node);
+			}               
+		}
+
+		//Resolves an absolute path. Resolved paths are cached until the tree is changed by Rename, Move or Delete.
+		VFSNode GetNodeInfo(std::string_view Path)
+		{
+			size_t Hash = std::hash<std::string_view>()(Path);
+			uint64_t Generation;
+			{
+				std::shared_lock<std::shared_mutex> lock(m_CacheLock);
+				Generation = m_Generation;
+				auto It = m_PathCache.find(Hash);
+				if(It != m_PathCache.end() && It->second.Generation == Generation && It->second.Path == Path)
+				{
+					if(auto Ret = It->second.Node.lock())
+						return Ret;
+				}
+			}
+
+			//The entry keeps the generation read before resolving, so a change that runs meanwhile makes it miss.
+			VFSNode Ret = Resolve(m_Root, Path);
+			if(Ret)
+			{
+				std::lock_guard<std::shared_mutex> lock(m_CacheLock);
+				if(Generation == m_Generation)
+				{
+					if(m_PathCache.size() >= MAX_PATH_CACHE)
+						m_PathCache.clear();
+
+					m_PathCache[Hash] = SPathCacheEntry{std::string(Path), Ret, Generation};
+				}
+			}
+
+			return Ret;
+		}
+
+		//Resolves a path relative to an already resolved directory, without using the path cache.
+		VFSNode GetNodeInfoAt(VFSNode Dir, std::string_view Path)
+		{
+			if(!Dir || !Dir->IsDir())
+				throw CVFSException("Given node is not a directory", VFSError::NODE_IS_FILE);
+
+			return Resolve(Dir, Path);
+		}
+
+		bool NodeExists(std::string_view Path)
+		{
+			return GetNodeInfo(Path) != nullptr; 
+		}
+
+		std::vector<VFSNode> List(std::string_view Path)
+		{
+			auto node = GetNodeInfo(Path);
+			return List(node);
+		}
+
+		std::vector<VFSNode> List(VFSNode node)
+		{
+			std::vector<VFSNode> Ret;
+			if(node && node->IsDir())
+			{
+				auto Dir = std::static_pointer_cast<CVFSDir>(node);
+				Ret = Dir->GetChilds();
+				if(!m_Options.NoAtime)
+					Dir->Touch();
+			}
+			else if(node && !node->IsDir())
+				throw CVFSException("Given node is not a directory", VFSError::NODE_IS_FILE);
+
+			return Ret;
+		}
+
+		std::vector<VFSNode> ListAt(VFSNode Dir, std::string_view Path = "")
+		{
+			return List(GetNodeInfoAt(Dir, Path));
+		}
+
+		using WalkVisitor = std::function<void(std::span<const SVFSEntry>)>;
+
+		//Passes all nodes below the directory in batches to Visit. The walk follows the nodes instead of resolving paths.
+		//With one thread the nodes arrive depth first in name order, parents before their childs. With more threads the
+		//subtrees are walked in parallel, Visit is called concurrently then and the order is undefined.
+		void Walk(std::string_view Path, const WalkVisitor &Visit, const SVFSWalkOptions &Options = SVFSWalkOptions())
+		{
+			auto Dir = AsDir(GetNodeInfo(Path));
+			if(!Dir)
+				throw CVFSException("Can't walk directory. Directory doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+
+			WalkTree(Dir, "", Visit, nullptr, Options);
+		}
+
+		//Passes the nodes matching the pattern in batches to Visit, like Walk(). Patterns are relative to the root,
+		//'*' and '?' match inside a path component, "**" matches across components, "**/" also matches no component.
+		//The walk starts at the directory named by the leading components without wildcards.
+		void Glob(std::string_view Pattern, const WalkVisitor &Visit, SVFSWalkOptions Options = SVFSWalkOptions())
+		{
+			while (!Pattern.empty() && Pattern.front() == '/')
+				Pattern.remove_prefix(1);
+
+			//Components without wildcards are resolved once instead of being matched against every node.
+			std::string Prefix;
+			size_t Split = Pattern.find_first_of("*?");
+			Split = Split == std::string_view::npos ? Pattern.rfind('/') : Pattern.rfind('/', Split);
+			if(Split != std::string_view::npos)
+				Prefix = std::string(Pattern.substr(0, Split + 1));
+
+			auto Dir = AsDir(GetNodeInfo("/" + Prefix));
+			if(!Dir)
+				return;
+
+			std::string_view Rest = Pattern.substr(Prefix.size());
+			if(Rest.find("**") == std::string_view::npos)
+			{
+				uint32_t Depth = std::count(Rest.begin(), Rest.end(), '/') + 1;
+				Options.MaxDepth = Options.MaxDepth ? std::min(Options.MaxDepth, Depth) : Depth;
+			}
+
+			auto Match = [Rest, Skip = Prefix.size()](const SVFSEntry &Entry) { return GlobMatch(Rest, std::string_view(Entry.Path).substr(Skip)); };
+			WalkTree(Dir, Prefix, Visit, Match, Options);
+		}
+
+		//Returns the matching nodes sorted by path.
+		std::vector<SVFSEntry> Glob(std::string_view Pattern, const SVFSWalkOptions &Options = SVFSWalkOptions())
+		{
+			std::vector<SVFSEntry> Ret;
+			std::mutex Lock;
+			Glob(Pattern, [&](std::span<const SVFSEntry> Entries)
+			{
+				std::lock_guard<std::mutex> lock(Lock);
+				Ret.insert(Ret.end(), Entries.begin(), Entries.end());
+			}, Options);
+
+			std::sort(Ret.begin(), Ret.end(), [](const SVFSEntry &a, const SVFSEntry &b) { return a.Path < b.Path; });
+			return Ret;
+		}
+
+		VFSFileStream Open(std::string_view Path, FileMode mode);
+		VFSFileStream OpenAt(VFSNode Dir, std::string_view Path, FileMode mode);
+
+		//Records the files in the order they are first opened for reading.
+		void StartAccessLog()
+		{
+			std::lock_guard<std::mutex> lock(m_AccessLock);
+			m_AccessLog.clear();
+			m_AccessLogged.clear();
+			m_LogAccess = true;
+		}
+
+		//Stops the recording and returns the paths of the recorded files in access order.
+		//Files, which were removed in the meantime, are skipped. See SVFSPackOptions::AccessOrder.
+		std::vector<std::string> StopAccessLog()
+		{
+			std::vector<VFSNode> Log;
+			{
+				std::lock_guard<std::mutex> lock(m_AccessLock);
+				m_LogAccess = false;
+				Log.swap(m_AccessLog);
+				m_AccessLogged.clear();
+			}
+
+			//Nodes don't know their parents, so the paths are taken from one walk of the tree.
+			std::unordered_map<const CVFSNode*, size_t> Order;
+			for (size_t i = 0; i < Log.size(); i++)
+				Order.emplace(Log[i].get(), i);
+
+			std::vector<std::string> Paths(Log.size());
+			Walk("/", [&](std::span<const SVFSEntry> Entries)
+			{
+				for (auto &&e : Entries)
+				{
+					auto It = Order.find(e.Node.get());
+					if(It != Order.end())
+						Paths[It->second] = "/" + e.Path;
+				}
+			});
+
+			std::erase_if(Paths, [](const std::string &e) { return e.empty(); });
+			return Paths;
+		}
+
+		size_t FileSize(VFSNode node)
+		{
+			if(!node->IsDir())
+			{
+				auto file = std::static_pointer_cast<CVFSFile>(node);
+				return file->Size();
+			}
+			else if(node && !node->IsDir())
+				throw CVFSException("Given node is not a file.", VFSError::NODE_IS_DIR);
+
+			return 0;
+		}
+
+		void Rename(const std::string &Path, const std::string &Name)
+		{
+			std::string_view NodeName;
+			auto Parent = AsDir(GetParent(Path, NodeName));
+
+			if(!Parent || !Parent->Search(NodeName))
+				throw CVFSException("Can't rename node. Node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+
+			if(Parent->Search(Name))
+				throw CVFSException("Can't rename node. Node already exists.", VFSError::NODE_ALREADY_EXISTS);
+
+			Parent->RenameChild(std::string(NodeName), Name);
+			RecordRename(Parent, NodeName, Name);
+			InvalidatePaths();
+		}
+
+		void Move(const std::string &From, const std::string &To)
+		{
+			std::shared_lock<std::shared_mutex> TreeLock(m_TreeLock);
+			std::string_view NodeName;
+			auto SrcParent = AsDir(GetParent(From, NodeName));
+			auto node = SrcParent ? SrcParent->Search(NodeName) : nullptr;
+			if(!node)
+				throw CVFSException("Can't move node. Source node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+
+			auto DestNode = GetNodeInfo(To);
+			if(!DestNode)
+				throw CVFSException("Can't move node. Destination node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+
+			if(!DestNode->IsDir())
+				throw CVFSException("Can't move node. Destination node is a file.", VFSError::NODE_IS_FILE);
+
+			auto DestParent = std::static_pointer_cast<CVFSDir>(DestNode);
+			if(DestParent->Search(NodeName))
+				throw CVFSException("Can't move node. Node already exists.", VFSError::NODE_ALREADY_EXISTS);
+
+			SrcParent->RemoveChild(std::string(NodeName));
+			DestParent->AppendChild(node);
+			RecordMove(SrcParent, NodeName, node, DestParent);
+			InvalidatePaths();
+		}
+
+		void Delete(const std::string &Path)
+		{
+			std::string_view NodeName;
+			auto Parent = AsDir(GetParent(Path, NodeName));
+
+			auto Node = Parent ? Parent->Search(NodeName) : nullptr;
+			if(!Node)
+				throw CVFSException("Can't delete node. Node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+
+			Parent->RemoveChild(std::string(NodeName));
+			RecordRemove(Parent, NodeName, Node);
+			InvalidatePaths();
+		}
+
+		void Copy(const std::string &From, const std::string &To)
+		{
+			std::shared_lock<std::shared_mutex> TreeLock(m_TreeLock);
+			auto node = GetNodeInfo(From);
+			if(!node)
+				throw CVFSException("Can't copy node. Source node doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+
+			std::string_view Name;
+			auto DestNode = GetParent(To, Name);
+			if(!DestNode)
+				throw CVFSException("Can't copy node. Destination node parent doesn't exists.", VFSError::NODE_DOESNT_EXISTS);
+
+			if(!DestNode->IsDir())
+				throw CVFSException("Can't copy node. Destination node parent is a file.", VFSError::NODE_IS_FILE);
+
+			auto DestParent = std::static_pointer_cast<CVFSDir>(DestNode);
+			if(DestParent->Search(Name))
+				throw CVFSException("Can't copy node. Destination node already exists.", VFSError::NODE_ALREADY_EXISTS);
+
+			auto copy = node->Copy();
+			copy->m_Name = Name;
+
+			DestParent->AppendChild(copy);
+			RecordNode(copy, DestParent);
+		}
+
+		std::vector<char> Serialize()
+		{
+			std::vector<char> Ret;
+			Serialize([&Ret](const char *Data, size_t Size) { Ret.insert(Ret.end(), Data, Data + Size); });
+			return Ret;
+		}
+
+		void Serialize(std::ostream &Out)
+		{
+			Serialize(StreamSink(Out));
+		}
+
+		//Writes the image to a host file descriptor.
+		void Serialize(int Fd)
+		{
+			Serialize(FdSink(Fd));
+		}
+
+		//Streams the image to the sink, only a small buffer is held in memory.
+		//Concurrent writes may or may not be part of the image, use Snapshot() for a consistent image.
+		void Serialize(const CVFSWriter::Sink &Sink)
+		{
+			SerializeImage(Sink, nullptr);
+		}
+
+		//Returns a point in time view of the tree, which can be serialized on another thread while the tree is changed.
+		std::shared_ptr<CVFSSnapshot> Snapshot();
+
+		//Packed images store the file data in independently compressed blocks, see SVFSPackOptions.
+		std::vector<char> Pack(const SVFSPackOptions &Options = SVFSPackOptions())
+		{
+			std::vector<char> Ret;
+			Pack([&Ret](const char *Data, size_t Size) { Ret.insert(Ret.end(), Data, Data + Size); }, Options);
+			return Ret;
+		}
+
+		void Pack(std::ostream &Out, const SVFSPackOptions &Options = SVFSPackOptions())
+		{
+			Pack(StreamSink(Out), Options);
+		}
+
+		void Pack(int Fd, const SVFSPackOptions &Options = SVFSPackOptions())
+		{
+			Pack(FdSink(Fd), Options);
+		}
+
+		void Pack(const CVFSWriter::Sink &Sink, const SVFSPackOptions &Options)
+		{
+			if(Options.BlockSize == 0)
+				throw CVFSException("Can't pack filesystem. Invalid block size.", VFSError::CANT_CREATE_FILESYSTEM);
+
+			try
+			{
+				CVFSWriter Out(Sink);
+				Out.Write(PACK_MAGIC.data(), PACK_MAGIC.size());
+				Out.Write(&PACK_VERSION, sizeof(PACK_VERSION));
+				Out.Write(&Options.BlockSize, sizeof(Options.BlockSize));
+				Out.Fill(BlockPadding(Out.Tell()));
+
+				SPackState State{Out, Options.BlockSize};
+				State.Threads = Options.Threads ? Options.Threads : Threads::ThreadPool::Global().Size();
+				State.Dedup = Options.Dedup;
+				State.Raw.resize(Options.BlockSize);
+				State.Pending.resize(State.Threads * 4);
+				State.PendingSizes.resize(State.Pending.size());
+				State.Compressed.resize(State.Pending.size());
+				State.CompressedSizes.resize(State.Pending.size());
+
+				//The files of the access order are stored first, so reading them in this order reads the image sequentially.
+				std::vector<VFSNode> Hot;
+				for (auto &&Path : Options.AccessOrder)
+				{
+					auto File = GetNodeInfo(Path);
+					if(File && !File->IsDir() && !State.Packed.count(File.get()))
+					{
+						State.Packed.emplace(File.get(), PackFile(State, static_cast<CVFSFile*>(File.get())));
+						Hot.push_back(File);
+					}
+				}
+
+				FlushBlocks(State);
+				uint64_t HotEnd = Hot.empty() ? 0 : Out.Tell();
+
+				auto Childs = m_Root->GetChilds();
+				std::vector<uint64_t> Subtrees;
+				for (auto e : Childs)
+				{
+					Subtrees.push_back(State.Nodes.size());
+					PackNode(State, e.get());
+				}
+
+				FlushBlocks(State);
+
+				SPackFooter Footer{};
+				Footer.HotEnd = HotEnd;
+				Footer.BlockIndexOffset = Out.Tell();
+				Footer.BlockCount = State.Blocks.size();
+				Out.Write(State.Blocks.data(), State.Blocks.size() * sizeof(SVFSBlockEntry));
+
+				Footer.NodeTableOffset = Out.Tell();
+				Footer.NodeTableSize = State.Nodes.size();
+				Footer.RootEntries = Childs.size();
+				Out.Write(State.Nodes.data(), State.Nodes.size());
+
+				Footer.SubtreeTableOffset = Out.Tell();
+				Out.Write(Subtrees.data(), Subtrees.size() * sizeof(uint64_t));
+
+				Out.Write(&Footer, sizeof(Footer));
+				Out.Flush();
+			}
+			catch(const std::bad_alloc &e)
+			{
+				throw CVFSException("Can't create stream. Out of mem. bad_alloc: " + std::string(e.what()), VFSError::OUT_OF_MEM);
+			}
+		}
+
+		//Loads an image into the filesystem. Its nodes replace existing nodes with the same name, like mounts do.
+		void Deserialize(const std::vector<char> &Data)
+		{
+			SImageReader In{Data.data(), Data.size(), 0};
+			DeserializeImage(In, nullptr);
+			InvalidatePaths();
+		}
+
+		//Mounts a disk image without reading it. The image is mapped into memory and files read
+		//directly from the mapping until they are written for the first time.
+		void MountImage(const std::string &HostPath)
+		{
+			auto Image = std::make_shared<const CMappedImage>(HostPath);
+			if(!Image->IsOpen())
+				throw CVFSException("Can't mount image. Can't open file: " + HostPath, VFSError::CANT_OPEN_FILE);
+
+			SImageReader In{Image->Data(), Image->Size(), 0};
+			DeserializeImage(In, Image);
+			InvalidatePaths();
+		}
+
+		//Backs the directory Path with a host directory. Only the directory tree is scanned, the files
+		//are read on their first access through the content cache (see SVFSOptions::CacheSize).
+		//Mounted nodes replace existing nodes with the same name, writes stay inside the VFS.
+		void MountHostDir(const std::string &Path, const std::string &HostPath)
+		{
+			std::error_code Err;
+			if(!std::filesystem::is_directory(HostPath, Err))
+				throw CVFSException("Can't mount directory: " + HostPath, VFSError::CANT_OPEN_FILE);
+
+			MountHostEntries(MountPoint(Path), HostPath);
+			InvalidatePaths();
+		}
+
+		//Backs the directory Path with a read only zip archive. The central directory is read once,
+		//stored entries are read from the mapped archive and deflated entries inflated on their first access.
+		void MountZip(const std::string &Path, const std::string &ZipPath)
+		{
+			auto Zip = std::make_shared<const CZipArchive>(ZipPath);
+			if(!Zip->IsOpen())
+				throw CVFSException("Can't mount zip archive: " + ZipPath, VFSError::CANT_OPEN_FILE);
+
+			auto Root = MountPoint(Path);
+			for (auto &&e : Zip->Entries())
+			{
+				auto Dir = Root;
+				std::string_view Name;
+				std::string_view Segment;
+				std::string_view Parent = SplitName(e.Name, Name);
+				size_t Pos = 0;
+
+				bool Valid = true;
+				while (Valid && NextSegment(Parent, Pos, Segment))
+				{
+					Valid = Segment != "." && Segment != "..";
+					if(Valid)
+						Dir = MountSubDir(Dir, Segment);
+				}
+
+				if(!Valid || Name.empty() || Name == "." || Name == "..")
+					continue;
+
+				if(e.Name.back() == '/')
+					MountSubDir(Dir, Name);
+				else
+				{
+					auto File = NewFile(std::string(Name));
+					File->m_Size = e.Size;
+					File->m_Modified = e.Modified;
+					File->m_Backing = std::make_shared<CVFSZipRegion>(Zip, e, m_Cache);
+					MountNode(Dir, File);
+				}
+			}
+
+			InvalidatePaths();
+		}
+
+		//Writes a full image like Serialize() and starts the journal. Afterwards SaveJournal() stores only
+		//the changes since the last save. The journal refers to nodes by ids, which stay the same for the
+		//lifetime of a node and are stored in the image behind the nodes. Writers have to be stopped like for Serialize().
+		void Checkpoint(const CVFSWriter::Sink &Sink)
+		{
+			NumberNodes(m_Root, nullptr);
+			{
+				std::lock_guard<std::mutex> lock(m_Changes->m_Lock);
+				m_Changes->m_Records.clear();
+				m_Changes->m_Dirty.clear();
+				m_Changes->m_Nodes.clear();
+				m_Changes->m_Active = true;
+			}
+
+			Serialize(Sink);
+		}
+
+		void Checkpoint(int Fd)
+		{
+			Checkpoint(FdSink(Fd));
+		}
+
+		//Appends the changes since the last save as one segment to the journal: new nodes, changes of the tree
+		//and the data written to files since then, so the cost depends only on the size of the changes.
+		//Returns false, if nothing changed. If the sink fails, the journal stops and a new checkpoint is needed.
+		//Mounts aren't journaled, mounted nodes are stored by the next checkpoint.
+		bool SaveJournal(const CVFSWriter::Sink &Sink)
+		{
+			if(!m_Changes->Active())
+				throw CVFSException("Can't save journal. No checkpoint was written.", VFSError::FAILED_TO_WRITE_STREAM);
+
+			try
+			{
+				std::vector<char> Segment(sizeof(SJournalHeader));
+				std::vector<std::weak_ptr<CVFSFile>> Dirty;
+				{
+					std::lock_guard<std::mutex> lock(m_Changes->m_Lock);
+					Segment.insert(Segment.end(), m_Changes->m_Records.begin(), m_Changes->m_Records.end());
+					m_Changes->m_Records.clear();
+					m_Changes->m_Nodes.clear();
+					Dirty.swap(m_Changes->m_Dirty);
+				}
+
+				for (auto &&e : Dirty)
+				{
+					if(auto File = e.lock())
+						JournalData(Segment, *File);
+				}
+
+				if(Segment.size() == sizeof(SJournalHeader))
+					return false;
+
+				SJournalHeader Header{};
+				memcpy(Header.Magic, JOURNAL_MAGIC, sizeof(Header.Magic));
+				Header.Version = JOURNAL_VERSION;
+				Header.Sequence = ++m_Changes->m_Sequence;
+				Header.Size = Segment.size() - sizeof(Header);
+				Header.Checksum = Hash::XXH64(Segment.data() + sizeof(Header), Header.Size);
+				memcpy(Segment.data(), &Header, sizeof(Header));
+
+				CVFSWriter Out(Sink);
+				Out.Write(Segment.data(), Segment.size());
+				Out.Flush();
+				return true;
+			}
+			catch(...)
+			{
+				m_Changes->m_Active = false;
+				throw;
+			}
+		}
+
+		bool SaveJournal(int Fd)
+		{
+			return SaveJournal(FdSink(Fd));
+		}
+
+		//Applies a journal to the tree loaded from its checkpoint (Deserialize() or MountImage()) and continues it.
+		//Segments, which are already part of the checkpoint, are skipped and several journals can be replayed in order.
+		//Replay stops at the first incomplete or damaged segment, which is the tail of an interrupted save,
+		//and returns the size of the intact part.
+		size_t ReplayJournal(const char *Data, size_t Size)
+		{
+			auto &Log = *m_Changes;
+			if(!Log.Active())
+				NumberNodes(m_Root, &Log.m_Nodes);
+			else if(Log.m_Nodes.empty())
+				throw CVFSException("Can't replay journal. Changes were saved since the checkpoint was loaded.", VFSError::CANT_CREATE_FILESYSTEM);
+
+			Log.m_Active = false;  //Replayed changes aren't recorded again.
+
+			size_t Pos = 0;
+			try
+			{
+				SJournalHeader Header;
+				while (Size - Pos >= sizeof(Header))
+				{
+					memcpy(&Header, Data + Pos, sizeof(Header));
+					const char *Records = Data + Pos + sizeof(Header);
+					if(memcmp(Header.Magic, JOURNAL_MAGIC, sizeof(Header.Magic)) != 0 || Header.Version != JOURNAL_VERSION || Header.Size > Size - Pos - sizeof(Header)
+						|| Hash::XXH64(Records, Header.Size) != Header.Checksum)
+						break;
+
+					if(Header.Sequence > Log.m_Sequence)
+					{
+						if(Header.Sequence != Log.m_Sequence + 1)
+							throw CVFSException("Can't replay journal. Segments are missing.", VFSError::CANT_CREATE_FILESYSTEM);
+
+						SImageReader In{Records, Header.Size, 0};
+						while (In.Pos < In.Size)
+							ReplayRecord(In, Log.m_Nodes);
+
+						Log.m_Sequence = Header.Sequence;
+					}
+
+					Pos += sizeof(Header) + Header.Size;
+				}
+			}
+			catch(const std::bad_alloc &e)
+			{
+				throw CVFSException("Can't replay journal. Out of mem. bad_alloc: " + std::string(e.what()), VFSError::OUT_OF_MEM);
+			}
+
+			Log.m_Active = true;
+			return Pos;
+		}
+
+		size_t ReplayJournal(const std::vector<char> &Journal)
+		{
+			return ReplayJournal(Journal.data(), Journal.size());
+		}
+
+		inline bool Journaling() const
+		{
+			return m_Changes->Active();
+		}
+
+		size_t ReadVector(const std::vector<char> &Data, char *Buf, size_t Size, size_t &Pos)
+		{
+			size_t CopyCount = (Pos + Size) < Data.size() ? Size : (Data.size() - Pos);
+			if(CopyCount > Data.size())
+			   throw CVFSException("Can't create filesystem.", VFSError::FAILED_TO_READ_STREAM);
+
+			memcpy(Buf, Data.data() + Pos, CopyCount);
+			Pos += CopyCount;
+
+			return CopyCount;
+		}
+
+		//Memory used by file contents and the effect of deduplication.
+		SVFSStats Stats() const
+		{
+			SVFSStats Ret;
+			Ret.ChunkMemory = m_Pool->InUse() * CHUNK_SIZE;
+			if(m_Store)
+				Ret.DedupedChunks = m_Store->Deduped();
+
+			return Ret;
+		}
+
+		~CVFS() {}
+	private:
+		const std::string MAGIC = "CVFS-DISK";
+		const std::string PACK_MAGIC = "CVFS-PACK";
+		static constexpr uint32_t PACK_VERSION = 2;
+		const int DISK_CHUNK_SIZE = 128;
+		const std::string NODE_IDENTIFIER = "NODE";
+		static constexpr char JOURNAL_MAGIC[4] = {'J', 'S', 'E', 'G'};
+		static constexpr uint32_t JOURNAL_VERSION = 1;
+		static constexpr char NODE_IDS_MAGIC[4] = {'N', 'I', 'D', 'S'};
+		static constexpr uint64_t ROOT_ID = 1;
+
+		class CVFSFile;
+		class CVFSDir;
+		class CVFSChunkStore;
+		class CVFSChangeLog;
+
+		using VFSFile = std::shared_ptr<CVFSFile>;
+		using VFSDir = std::shared_ptr<CVFSDir>;
+		
+		class CVFSFile : public CVFSNode
+		{
+			friend CVFS;
+			friend CVFSChunkStore;
+			friend CVFSSnapshot;
+
+			public:
+				CVFSFile(std::shared_ptr<CVFSChunkPool> Pool = nullptr, std::shared_ptr<CVFSChunkStore> Store = nullptr) : CVFSNode(), m_Pool(Pool ? Pool : CVFSChunkPool::Default()), m_Store(Store)
+				{
+					m_IsDir = false;
+					m_Modified = Now();
+					m_Size = 0;
+				}
+
+				CVFSFile(const std::string &Name, std::shared_ptr<CVFSChunkPool> Pool = nullptr, std::shared_ptr<CVFSChunkStore> Store = nullptr) : CVFSFile(Pool, Store)
+				{
+					m_Name = Name;
+				}
+
+				CVFSFile(const CVFSFile &file) : CVFSNode(file), m_Pool(file.m_Pool), m_Store(file.m_Store), m_Changes(file.m_Changes)
+				{
+					std::shared_lock<std::shared_mutex> lock(file.m_UpdateLock);
+					m_Modified = file.m_Modified.load();
+					m_Size = file.m_Size.load();
+					m_Backing = file.m_Backing;
+
+					if(file.m_Data.empty() && !m_Backing)
+						memcpy(m_Inline, file.m_Inline, m_Size);
+					else
+						m_Data = file.m_Data;   //The chunks are shared until one of the files writes into them.
+				}
+
+				void Clear()
+				{
+					std::lock_guard<std::shared_mutex> lock(m_UpdateLock);
+					Preserve();
+					m_Data.clear();
+					m_Backing.reset();
+					m_Size = 0;
+					m_Version++;
+
+					m_SavedSize = 0;
+					m_Truncated = true;
+					MarkDirty();
+				}
+
+				size_t Write(const char *Data, size_t Size)
+				{
+					std::lock_guard<std::shared_mutex> lock(m_UpdateLock);
+					Preserve();
+
+					if(m_Backing)
+						Materialize();
+
+					size_t FirstChunk = m_Size / CHUNK_SIZE;
+					if(m_Data.empty() && (m_Size + Size) <= INLINE_SIZE)   //Small files stay inside the node.
+					{
+						memcpy(m_Inline + m_Size, Data, Size);
+						m_Size += Size;
+					}
+					else
+					{
+						if(m_Data.empty())  //Moves the inline data into the first chunk.
+						{
+							ReserveChunks(1);
+							memcpy(m_Data[0]->Data, m_Inline, m_Size);
+							m_Data[0]->Filled = m_Size;
+						}
+
+						size_t ChunkCount = (m_Size + Size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+						if(ChunkCount > m_Data.size())    //Allocate new chunks, if we are exhausted.
+							ReserveChunks(ChunkCount - m_Data.size());
+
+						size_t Written = 0;
+						size_t ChunkPos = m_Size / CHUNK_SIZE;  //Calculates the beginning chunk.
+
+						while (Written < Size)
+						{
+							Chunk &c = PrivateChunk(ChunkPos);
+							size_t Free = c->Size - c->Filled;
+							size_t CopyCount = ((Size - Written) >= Free) ? Free : (Size - Written);    //Calculate the right copy size.
+
+							memcpy(c->Data + c->Filled, Data + Written, CopyCount);
+							c->Filled += CopyCount; //Chunk update
+							m_Size += CopyCount;  
+							Written += CopyCount;
+							ChunkPos++;
+						}
+
+						InternChunks(FirstChunk);
+					}
+
+					m_Modified = Now();
+					m_Version++;
+					MarkDirty();
+					return Size;
+				}
+
+				//Concurrent reads only share the lock, the access time is updated by the caller, see Touch().
+				size_t Read(char *Buf, size_t Size, size_t CurPos) const
+				{
+					std::shared_lock<std::shared_mutex> lock(m_UpdateLock);
+
+					size_t Readed = 0;
+					if(m_Backing)
+						Readed = m_Backing->Read(Buf, Size, CurPos);
+					else if(m_Data.empty() && CurPos < m_Size)
+					{
+						Readed = std::min(Size, m_Size - CurPos);
+						memcpy(Buf, m_Inline + CurPos, Readed);
+					}
+
+					size_t ChunkPos = CurPos / CHUNK_SIZE; //Calculates the beginning chunk.
+					while (Readed < Size)
+					{
+						if(ChunkPos >= m_Data.size())
+							break;
+
+						const Chunk &c = m_Data[ChunkPos];    //No copy, the reference count is shared between all readers.
+						size_t Pos = (CurPos + Readed) - ChunkPos * CHUNK_SIZE;
+
+						size_t Filled = c->Filled;
+						if(Pos >= Filled)
+							break;
+
+						size_t CopyCount = std::min(Filled - Pos, Size - Readed);    //Calculate the right copy size.
+						memcpy(Buf + Readed, c->Data + Pos, CopyCount);
+						Readed += CopyCount;
+						ChunkPos++;
+					}
+
+					return Readed;
+				}
+
+				//Calls Func(const char *Data, size_t Size) for every continuous part of the file.
+				//The content is taken under the lock, so concurrent writes aren't seen.
+				template<class F>
+				void ForEachSegment(F Func) const
+				{
+					Content().ForEachSegment(Func);
+				}
+
+				//Appends the data in [Pos, Pos + Size) to Out. The chunks are shared with the view instead of copied.
+				void View(size_t Pos, size_t Size, CVFSView &Out) const
+				{
+					std::shared_lock<std::shared_mutex> lock(m_UpdateLock);
+					InternalView(Pos, Size, Out);
+				}
+
+				inline time_t Modified() const
+				{
+					return m_Modified.load(std::memory_order_relaxed);
+				}
+
+				inline size_t Size() const
+				{
+					return m_Size.load(std::memory_order_acquire);
+				}
+
+				//Changes with every write, buffered readers use it to detect stale data.
+				inline uint64_t Version() const
+				{
+					return m_Version.load(std::memory_order_acquire);
+				}
+
+				VFSNode Copy() override
+				{
+					return VFSFile(new CVFSFile(*this));
+				}
+
+			private:
+				static constexpr size_t INLINE_SIZE = 256;
+
+				struct SChunk
+				{
+					public:
+						SChunk(std::shared_ptr<CVFSChunkPool> Pool) : Pool(Pool)
+						{
+							Size = CHUNK_SIZE;
+							Filled = 0;
+							Data = Pool->Alloc();
+						}
+
+						int Size;
+						int Filled;
+						char *Data;
+						std::shared_ptr<CVFSChunkPool> Pool;
+
+						~SChunk()
+						{
+							Pool->Free(Data);
+						}
+				};
+
+				using Chunk = std::shared_ptr<SChunk>;
+
+				//Content of the file at one point in time, the chunks and the backing are shared with the file.
+				struct SContent
+				{
+					std::vector<Chunk> Data;
+					std::shared_ptr<IVFSBacking> Backing;
+					std::string Inline;
+					size_t Size = 0;
+					time_t Modified = 0;
+
+					template<class F>
+					void ForEachSegment(F Func) const
+					{
+						if(Backing)
+							Backing->ForEachSegment(Func);
+						else if(Data.empty())
+						{
+							if(Size != 0)
+								Func(Inline.data(), Size);
+						}
+						else
+						{
+							for (auto &&e : Data)
+							{
+								if(e->Filled == 0)
+									break;
+
+								Func(e->Data, (size_t)e->Filled);
+							}
+						}
+					}
+				};
+
+				SContent Content() const
+				{
+					std::shared_lock<std::shared_mutex> lock(m_UpdateLock);
+					return InternalContent();
+				}
+
+				SContent InternalContent() const
+				{
+					SContent Ret;
+					Ret.Size = m_Size;
+					Ret.Modified = m_Modified;
+					Ret.Backing = m_Backing;
+					if(!m_Backing && m_Data.empty())
+						Ret.Inline.assign(m_Inline, m_Size);
+					else
+						Ret.Data = m_Data;
+
+					return Ret;
+				}
+
+				void InternalView(size_t Pos, size_t Size, CVFSView &Out) const
+				{
+					Size = Pos < m_Size ? std::min(Size, m_Size - Pos) : 0;
+					if(Size == 0)
+						return;
+
+					if(m_Backing)
+						m_Backing->View(Pos, Size, Out);
+					else if(m_Data.empty())
+					{
+						auto Buf = std::make_shared<std::vector<char>>(m_Inline + Pos, m_Inline + Pos + Size);
+						Out.Append(Buf->data(), Buf->size(), Buf);
+					}
+					else
+					{
+						for (size_t ChunkPos = Pos / CHUNK_SIZE, Done = 0; Done < Size; ChunkPos++)
+						{
+							const Chunk &c = m_Data[ChunkPos];
+							size_t Offset = (Pos + Done) - ChunkPos * CHUNK_SIZE;
+							size_t Count = std::min(Size - Done, (size_t)c->Filled - Offset);
+
+							Out.Append(c->Data + Offset, Count, c);
+							Done += Count;
+						}
+					}
+				}
+
+				//Copies the backing data into the file.
+				void Materialize()
+				{
+					auto Backing = std::move(m_Backing);
+					if(m_Size <= INLINE_SIZE)
+						Backing->Read(m_Inline, m_Size, 0);
+					else
+					{
+						ReserveChunks((m_Size + CHUNK_SIZE - 1) / CHUNK_SIZE);
+						for (size_t i = 0; i < m_Data.size(); i++)
+							m_Data[i]->Filled = Backing->Read(m_Data[i]->Data, CHUNK_SIZE, i * CHUNK_SIZE);
+
+						InternChunks(0);
+					}
+				}
+
+				//Queues the file for the next journal save, see CVFS::SaveJournal().
+				void MarkDirty()
+				{
+					if(!m_Dirty && m_Changes && m_Changes->Active())
+					{
+						m_Dirty = true;
+						m_Changes->AddDirty(std::static_pointer_cast<CVFSFile>(shared_from_this()));
+					}
+				}
+
+				//Passes the full chunks from First on to the chunk store, if deduplication is enabled.
+				void InternChunks(size_t First)
+				{
+					if(!m_Store)
+						return;
+
+					for (size_t i = First; i < m_Data.size() && m_Data[i]->Filled == CHUNK_SIZE; i++)
+						m_Store->Intern(m_Data[i]);
+				}
+
+				//Makes a private copy of the chunk, if other files or views still share it.
+				//Chunks in the store are always full and writes only touch the last, partial chunk, so a chunk can only
+				//gain new owners by copying or viewing this file under its lock and use_count() is reliable here.
+				Chunk &PrivateChunk(size_t Pos)
+				{
+					Chunk &c = m_Data[Pos];
+					if(c.use_count() > 1)
+					{
+						auto Copy = std::make_shared<SChunk>(m_Pool);
+						Copy->Filled = c->Filled;
+						memcpy(Copy->Data, c->Data, c->Filled);
+						c = Copy;
+					}
+
+					return c;
+				}
+
+				void ReserveChunks(size_t Count)
+				{
+					if(m_Data.capacity() < m_Data.size() + Count)
+						m_Data.reserve(std::max(m_Data.size() * 2, m_Data.size() + Count));
+
+					for (size_t i = 0; i < Count; i++)
+						m_Data.push_back(std::make_shared<SChunk>(m_Pool));
+				}
+
+				std::atomic<time_t> m_Modified;
+				std::atomic<size_t> m_Size;   //Only changed under the exclusive lock, readable without it.
+				std::atomic<uint64_t> m_Version{0};
+
+				std::shared_ptr<CVFSChunkPool> m_Pool;
+				std::shared_ptr<CVFSChunkStore> m_Store;	//Null, if deduplication is disabled.
+				std::shared_ptr<CVFSChangeLog> m_Changes;
+
+				//Journal state, the next save stores the data behind m_SavedSize.
+				size_t m_SavedSize = 0;
+				bool m_Truncated = false;
+				bool m_Dirty = false;
+				std::shared_ptr<IVFSBacking> m_Backing; //Holds the data until the first write, if set.
+				std::vector<Chunk> m_Data;  //Empty as long as the file fits into m_Inline.
+				char m_Inline[INLINE_SIZE];
+		};
+
+		//Content addressed index of the full chunks of all files. Identical chunks are stored once and shared
+		//between the files, the copy on write of CVFSFile::PrivateChunk() keeps them apart on modification.
+		//The index only holds weak references, chunks are freed with the last file using them.
+		class CVFSChunkStore
+		{
+			public:
+				//Replaces the chunk with an identical, already known chunk or adds it to the index.
+				void Intern(CVFSFile::Chunk &c)
+				{
+					uint64_t Key = Hash::XXH64(c->Data, CHUNK_SIZE);
+
+					std::lock_guard<std::mutex> lock(m_Lock);
+					auto Range = m_Chunks.equal_range(Key);
+					for (auto it = Range.first; it != Range.second; ++it)
+					{
+						auto Known = it->second.lock();
+						if(!Known)
+						{
+							it->second = c;
+							return;
+						}
+
+						if(Known == c)
+							return;
+
+						if(memcmp(Known->Data, c->Data, CHUNK_SIZE) == 0)
+						{
+							c = std::move(Known);
+							m_Deduped++;
+							return;
+						}
+					}
+
+					m_Chunks.emplace(Key, c);
+					if(m_Chunks.size() >= m_SweepAt)
+						Sweep();
+				}
+
+				uint64_t Deduped() const
+				{
+					std::lock_guard<std::mutex> lock(m_Lock);
+					return m_Deduped;
+				}
+
+			private:
+				//Drops the entries of freed chunks, the index is swept again once it doubled in size.
+				void Sweep()
+				{
+					for (auto it = m_Chunks.begin(); it != m_Chunks.end();)
+					{
+						if(it->second.expired())
+							it = m_Chunks.erase(it);
+						else
+							++it;
+					}
+
+					m_SweepAt = std::max<size_t>(1024, m_Chunks.size() * 2);
+				}
+
+				std::unordered_multimap<uint64_t, std::weak_ptr<CVFSFile::SChunk>> m_Chunks;
+				size_t m_SweepAt = 1024;
+				uint64_t m_Deduped = 0;
+				mutable std::mutex m_Lock;
+		};
+
+		//Collects the changes since the last journal save. Changes of the tree are recorded when they happen,
+		//changed files only queue themselves and their new data is read by the save.
+		class CVFSChangeLog
+		{
+			friend CVFS;
+
+			public:
+				inline bool Active() const
+				{
+					return m_Active.load(std::memory_order_acquire);
+				}
+
+				void AddDirty(const VFSFile &File)
+				{
+					std::lock_guard<std::mutex> lock(m_Lock);
+					m_Dirty.push_back(File);
+				}
+
+			private:
+				std::atomic<bool> m_Active{false};
+				uint64_t m_NextId = ROOT_ID + 1;
+				uint64_t m_Sequence = 0;	//Last saved or replayed segment.
+
+				std::vector<char> m_Records;
+				std::vector<std::weak_ptr<CVFSFile>> m_Dirty;
+				std::unordered_map<uint64_t, std::weak_ptr<CVFSNode>> m_Nodes;	//Nodes by id, kept between replays until the next save.
+				std::mutex m_Lock;
+		};
+
+		class CVFSDir : public CVFSNode
+		{
+			public:
+				CVFSDir() : CVFSNode()
+				{
+					m_IsDir = true;
+				}
+
+				CVFSDir(const std::string &Name) : CVFSDir()
 				{
 					m_Name = Name;
 				}
 
-				CVFSFile(const CVFSFile &file) : CVFSNode(file)
+				CVFSDir(const CVFSDir &dir) : CVFSNode(dir)
+				{
+					std::shared_lock<std::shared_mutex> lock(dir.m_UpdateLock);
+					m_Childs.reserve(dir.m_Childs.size());
+					for (auto &&e : dir.m_Childs)
+						InternalAppendChild(e->Copy());
+				}
+
+				void AppendChild(VFSNode Child)
+				{
+					std::lock_guard<std::shared_mutex> lock(m_UpdateLock);
+					Preserve();
+					InternalAppendChild(Child);
+				}
+
+				//Adds the nodes under one lock, the index is grown once. A node replaces the child with the same name,
+				//so for duplicates inside the range the last one wins.
+				template<class R>
+				void AppendChildren(R &&Childs)
+				{
+					if(std::ranges::empty(Childs))
+						return;
+
+					std::lock_guard<std::shared_mutex> lock(m_UpdateLock);
+					Preserve();
+					if constexpr (std::ranges::sized_range<R>)
+						Reserve(m_Childs.size() + std::ranges::size(Childs));
+
+					for (auto &&e : Childs)
+					{
+						size_t Pos = Find(e->m_Name);
+						if(Pos != NPOS)
+							InternalRemoveChild(Pos);
+
+						InternalAppendChild(e);
+					}
+				}
+
+				VFSNode Search(std::string_view Name)
+				{
+					std::shared_lock<std::shared_mutex> lock(m_UpdateLock);
+					size_t Pos = Find(Name);
+
+					return Pos != NPOS ? m_Childs[Pos] : nullptr;
+				}
+
+				void RenameChild(const std::string &Name, const std::string &NewName)
+				{
+					std::lock_guard<std::shared_mutex> lock(m_UpdateLock);
+					size_t Pos = Find(Name);
+					if(Pos != NPOS)
+					{
+						Preserve();
+						auto Child = m_Childs[Pos];
+						InternalRemoveChild(Pos); //Removes the child temporary.
+						{
+							std::lock_guard<std::shared_mutex> ChildLock(Child->m_UpdateLock);
+							Child->m_Name = NewName;
+						}
+
+						InternalAppendChild(Child);
+					}
+				}
+
+				void RemoveChild(const std::string &Name)
+				{
+					std::lock_guard<std::shared_mutex> lock(m_UpdateLock);
+					size_t Pos = Find(Name);
+					if(Pos != NPOS)
+					{
+						Preserve();
+						InternalRemoveChild(Pos);
+					}
+				}
+
+				//Returns the childs sorted by name.
+				std::vector<VFSNode> GetChilds()
+				{
+					std::shared_lock<std::shared_mutex> lock(m_UpdateLock);
+					std::vector<VFSNode> Ret = m_Childs;
+					std::sort(Ret.begin(), Ret.end(), [](const VFSNode &a, const VFSNode &b) { return a->m_Name < b->m_Name; });
+					return Ret;
+				}
+
+				VFSNode Copy() override
+				{
+					return VFSDir(new CVFSDir(*this));
+				}
+
+				//Returns the childs with their names sorted by name, the caller holds the lock.
+				std::vector<std::pair<std::string, VFSNode>> InternalNamedChilds() const
+				{
+					std::vector<std::pair<std::string, VFSNode>> Ret;
+					Ret.reserve(m_Childs.size());
+					for (auto &&e : m_Childs)
+						Ret.emplace_back(e->m_Name, e);
+
+					std::sort(Ret.begin(), Ret.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+					return Ret;
+				}
+
+			private:
+				static constexpr size_t NPOS = (size_t)-1;
+				static constexpr size_t MIN_INDEX_SIZE = 16;
+
+				//The childs are kept unordered. m_Index is an open addressing hash table (linear probing),
+				//which stores the position inside m_Childs + 1, 0 marks an empty slot.
+				//Names of the childs are only changed under the lock of the parent, so they can be compared
+				//without locking every child.
+				size_t Find(std::string_view Name) const
+				{
+					if(m_Index.empty())
+						return NPOS;
+
+					size_t Hash = std::hash<std::string_view>()(Name);
+					size_t Mask = m_Index.size() - 1;
+
+					for (size_t i = Hash & Mask; m_Index[i] != 0; i = (i + 1) & Mask)
+					{
+						size_t Pos = m_Index[i] - 1;
+						if(m_Hashes[Pos] == Hash && m_Childs[Pos]->m_Name == Name)
+							return Pos;
+					}
+
+					return NPOS;
+				}
+
+				size_t FindSlot(size_t Pos) const
+				{
+					size_t Mask = m_Index.size() - 1;
+					size_t i = m_Hashes[Pos] & Mask;
+					while (m_Index[i] != Pos + 1)
+						i = (i + 1) & Mask;
+
+					return i;
+				}
+
+				void InsertSlot(size_t Pos)
+				{
+					size_t Mask = m_Index.size() - 1;
+					size_t i = m_Hashes[Pos] & Mask;
+					while (m_Index[i] != 0)
+						i = (i + 1) & Mask;
+
+					m_Index[i] = Pos + 1;
+				}
+
+				void Reserve(size_t Count)
+				{
+					m_Childs.reserve(Count);
+					m_Hashes.reserve(Count);
+
+					size_t Size = std::max(MIN_INDEX_SIZE, m_Index.size());
+					while (Count * 2 > Size)
+						Size *= 2;
+
+					if(Size != m_Index.size())
+						Rehash(Size);
+				}
+
+				void Rehash(size_t Size)
+				{
+					m_Index.assign(Size, 0);
+					for (size_t i = 0; i < m_Childs.size(); i++)
+						InsertSlot(i);
+				}
+
+				void InternalAppendChild(VFSNode Child)
+				{
+					if((m_Childs.size() + 1) * 2 > m_Index.size())  //Keeps the load factor under 0.5.
+						Rehash(std::max(MIN_INDEX_SIZE, m_Index.size() * 2));
+
+					m_Hashes.push_back(std::hash<std::string_view>()(Child->m_Name));
+					m_Childs.push_back(Child);
+					InsertSlot(m_Childs.size() - 1);
+				}
+
+				void InternalRemoveChild(size_t Pos)
+				{
+					size_t Mask = m_Index.size() - 1;
+					size_t Hole = FindSlot(Pos);
+
+					//Backward shift deletion, so the probe sequences stay intact without tombstones.
+					for (size_t i = (Hole + 1) & Mask; m_Index[i] != 0; i = (i + 1) & Mask)
+					{
+						size_t Home = m_Hashes[m_Index[i] - 1] & Mask;
+						if(((i - Home) & Mask) >= ((i - Hole) & Mask))
+						{
+							m_Index[Hole] = m_Index[i];
+							Hole = i;
+						}
+					}
+
+					m_Index[Hole] = 0;
+
+					//Moves the last child into the freed position.
+					size_t Last = m_Childs.size() - 1;
+					if(Pos != Last)
+					{
+						m_Index[FindSlot(Last)] = Pos + 1;
+						m_Childs[Pos] = std::move(m_Childs[Last]);
+						m_Hashes[Pos] = m_Hashes[Last];
+					}
+
+					m_Childs.pop_back();
+					m_Hashes.pop_back();
+				}
+
+				std::vector<VFSNode> m_Childs;
+				std::vector<size_t> m_Hashes;
+				std::vector<uint32_t> m_Index;
+		};
+
+		struct SPathCacheEntry
+		{
+			std::string Path;
+			std::weak_ptr<CVFSNode> Node;
+			uint64_t Generation;
+		};
+
+		static constexpr size_t MAX_PATH_CACHE = 4096;
+
+		//Extracts the next path segment starting at Pos, empty segments are skipped.
+		static bool NextSegment(std::string_view Path, size_t &Pos, std::string_view &Segment)
+		{
+			while (Pos < Path.size() && Path[Pos] == '/')
+				Pos++;
+
+			if(Pos >= Path.size())
+				return false;
+
+			size_t End = std::min(Path.find('/', Pos), Path.size());
+			Segment = Path.substr(Pos, End - Pos);
+			Pos = End;
+
+			return true;
+		}
+
+		//Splits the path into the parent path and the node name, trailing slashes are ignored.
+		static std::string_view SplitName(std::string_view Path, std::string_view &Name)
+		{
+			while (!Path.empty() && Path.back() == '/')
+				Path.remove_suffix(1);
+
+			size_t Pos = Path.find_last_of('/');
+			if(Pos == std::string_view::npos)
+			{
+				Name = Path;
+				return std::string_view();
+			}
+
+			Name = Path.substr(Pos + 1);
+			return Path.substr(0, Pos);
+		}
+
+		VFSNode Resolve(VFSNode Node, std::string_view Path)
+		{
+			std::string_view Segment;
+			size_t Pos = 0;
+
+			while (Node && NextSegment(Path, Pos, Segment))
+			{
+				if(!Node->IsDir())
+					return nullptr;
+
+				Node = std::static_pointer_cast<CVFSDir>(Node)->Search(Segment);
+			}
+
+			return Node;
+		}
+
+		//Resolves the parent of the path, Name receives the last path segment.
+		VFSNode GetParent(std::string_view Path, std::string_view &Name)
+		{
+			return GetNodeInfo(SplitName(Path, Name));
+		}
+
+		static VFSDir AsDir(VFSNode Node)
+		{
+			return (Node && Node->IsDir()) ? std::static_pointer_cast<CVFSDir>(Node) : nullptr;
+		}
+
+		VFSDir MountPoint(const std::string &Path)
+		{
+			if(!GetNodeInfo(Path))
+				CreateDir(Path, true);
+
+			auto Dir = AsDir(GetNodeInfo(Path));
+			if(!Dir)
+				throw CVFSException("Can't mount. Mount point is a file: " + Path, VFSError::NODE_IS_FILE);
+
+			return Dir;
+		}
+
+		//Returns the sub directory Name, a file with this name is replaced.
+		VFSDir MountSubDir(const VFSDir &Dir, std::string_view Name)
+		{
+			if(auto Ret = AsDir(Dir->Search(Name)))
+				return Ret;
+
+			auto Ret = NewDir(std::string(Name));
+			MountNode(Dir, Ret);
+			return Ret;
+		}
+
+		void MountNode(const VFSDir &Dir, VFSNode Node)
+		{
+			Dir->RemoveChild(Node->m_Name);
+			Dir->AppendChild(Node);
+		}
+
+		//The entries of a host directory are added at once. New directories are filled before they become visible.
+		void MountHostEntries(const VFSDir &Dir, const std::filesystem::path &HostPath)
+		{
+			std::error_code Err;
+			std::vector<VFSNode> Nodes;
+			for (auto &&e : std::filesystem::directory_iterator(HostPath, Err))
+			{
+				std::string Name = e.path().filename().string();
+				if(e.is_directory(Err))
+				{
+					auto SubDir = AsDir(Dir->Search(Name));
+					if(!SubDir)
+					{
+						SubDir = NewDir(Name);
+						Nodes.push_back(SubDir);
+					}
+
+					MountHostEntries(SubDir, e.path());
+				}
+				else if(e.is_regular_file(Err))
+				{
+					auto Time = std::chrono::file_clock::to_sys(e.last_write_time(Err));
+
+					auto File = NewFile(Name);
+					File->m_Size = e.file_size(Err);
+					File->m_Modified = std::chrono::system_clock::to_time_t(Time);
+					File->m_Backing = std::make_shared<CVFSHostRegion>(e.path().string(), File->m_Size, m_Cache);
+					Nodes.push_back(File);
+				}
+			}
+
+			Dir->AppendChildren(Nodes);
+		}
+
+		VFSFile NewFile(const std::string &Name)
+		{
+			auto File = VFSFile(new CVFSFile(Name, m_Pool, m_Store));
+			File->m_Changes = m_Changes;
+			File->m_Snapshots = m_Snapshots;
+			File->m_Epoch = m_Snapshots->Epoch();
+			return File;
+		}
+
+		void LogAccess(const VFSNode &File, FileMode Mode)
+		{
+			if(!m_LogAccess.load(std::memory_order_relaxed) || (Mode & FileMode::READ) != FileMode::READ)
+				return;
+
+			std::lock_guard<std::mutex> lock(m_AccessLock);
+			if(m_LogAccess && m_AccessLogged.insert(File.get()).second)
+				m_AccessLog.push_back(File);
+		}
+
+		VFSDir NewDir(const std::string &Name)
+		{
+			auto Dir = VFSDir(new CVFSDir(Name));
+			Dir->m_Snapshots = m_Snapshots;
+			Dir->m_Epoch = m_Snapshots->Epoch();
+			return Dir;
+		}
+
+		using WalkFilter = std::function<bool(const SVFSEntry&)>;
+
+		//Directory, whose childs are still to be visited.
+		struct SWalkDir
+		{
+			VFSDir Dir;
+			std::string Path;   //Path of the childs, ends with a slash.
+			uint32_t Depth;
+		};
+
+		struct SWalkState
+		{
+			const WalkVisitor &Visit;
+			const WalkFilter &Filter;
+			const SVFSWalkOptions &Options;
+		};
+
+		//Buffers entries and hands them over in batches.
+		struct SWalkBatch
+		{
+			const SWalkState &State;
+			std::vector<SVFSEntry> Entries;
+
+			SWalkBatch(const SWalkState &State) : State(State)
+			{
+				Entries.reserve(std::max<size_t>(State.Options.BatchSize, 1));
+			}
+
+			void Add(SVFSEntry &&Entry)
+			{
+				if(State.Filter && !State.Filter(Entry))
+					return;
+
+				Entries.push_back(std::move(Entry));
+				if(Entries.size() >= State.Options.BatchSize)
+					Flush();
+			}
+
+			void Flush()
+			{
+				if(!Entries.empty())
+					State.Visit(std::span<const SVFSEntry>(Entries));
+
+				Entries.clear();
+			}
+		};
+
+		void WalkTree(VFSDir Dir, const std::string &Path, const WalkVisitor &Visit, const WalkFilter &Filter, const SVFSWalkOptions &Options)
+		{
+			SWalkState State{Visit, Filter, Options};
+			std::vector<SWalkDir> Pending{SWalkDir{Dir, Path, 1}};
+
+			//The top levels are listed on the calling thread, until there are enough subtrees for the pool.
+			unsigned Workers = Options.Threads ? Options.Threads : Threads::ThreadPool::Global().Size();
+			if(Workers > 1)
+			{
+				SWalkBatch Batch(State);
+				while (!Pending.empty() && Pending.size() < Workers * 4)
+				{
+					std::vector<SWalkDir> Next;
+					for (auto &&e : Pending)
+						WalkChilds(e, Batch, &Next);
+
+					Pending = std::move(Next);
+				}
+
+				Batch.Flush();
+			}
+
+			Threads::ThreadPool::Global().ParallelFor(Pending.size(), [&](size_t i)
+			{
+				SWalkBatch Batch(State);
+				WalkChilds(Pending[i], Batch, nullptr);
+				Batch.Flush();
+			}, Workers);
+		}
+
+		//Visits the childs of the directory. The subdirectories are walked depth first or are appended to Next.
+		void WalkChilds(const SWalkDir &Dir, SWalkBatch &Batch, std::vector<SWalkDir> *Next)
+		{
+			uint32_t MaxDepth = Batch.State.Options.MaxDepth;
+			if(MaxDepth && Dir.Depth > MaxDepth)
+				return;
+
+			for (auto &&e : NamedChilds(*Dir.Dir, nullptr))
+			{
+				SVFSEntry Entry;
+				Entry.Path = Dir.Path + e.first;
+				Entry.Node = e.second;
+				Entry.Depth = Dir.Depth;
+				Entry.IsDir = e.second->IsDir();
+				Entry.Created = e.second->Created();
+				if(Entry.IsDir)
+				{
+					Entry.Size = 0;
+					Entry.Modified = Entry.Created;
+				}
+				else
+				{
+					auto File = static_cast<CVFSFile*>(e.second.get());
+					Entry.Size = File->Size();
+					Entry.Modified = File->Modified();
+				}
+
+				if(!Entry.IsDir)
+				{
+					Batch.Add(std::move(Entry));
+					continue;
+				}
+
+				SWalkDir Child{std::static_pointer_cast<CVFSDir>(e.second), Entry.Path + "/", Dir.Depth + 1};
+				Batch.Add(std::move(Entry));
+				if(Next)
+					Next->push_back(std::move(Child));
+				else
+					WalkChilds(Child, Batch, nullptr);
+			}
+
+			if(!m_Options.NoAtime)
+				Dir.Dir->Touch();
+		}
+
+		//Matches the path against a glob pattern, see Glob().
+		static bool GlobMatch(std::string_view Pattern, std::string_view Path)
+		{
+			while (!Pattern.empty())
+			{
+				if(Pattern.substr(0, 2) == "**")
+				{
+					Pattern.remove_prefix(2);
+					if(!Pattern.empty() && Pattern.front() == '/' && GlobMatch(Pattern.substr(1), Path))
+						return true;
+
+					bool Literal = !Pattern.empty() && Pattern.front() != '*' && Pattern.front() != '?';
+					for (size_t i = 0; i <= Path.size(); i++)
+					{
+						if((!Literal || (i < Path.size() && Path[i] == Pattern.front())) && GlobMatch(Pattern, Path.substr(i)))
+							return true;
+					}
+
+					return false;
+				}
+
+				if(Pattern.front() == '*')
+				{
+					Pattern.remove_prefix(1);
+					for (size_t i = 0; ; i++)
+					{
+						if(GlobMatch(Pattern, Path.substr(i)))
+							return true;
+
+						if(i == Path.size() || Path[i] == '/')
+							return false;
+					}
+				}
+
+				if(Path.empty() || (Pattern.front() == '?' ? Path.front() == '/' : Pattern.front() != Path.front()))
+					return false;
+
+				Pattern.remove_prefix(1);
+				Path.remove_prefix(1);
+			}
+
+			return Path.empty();
+		}
+
+		void InvalidatePaths()
+		{
+			std::lock_guard<std::shared_mutex> lock(m_CacheLock);
+			m_Generation++;
+		}
+
+		static CVFSWriter::Sink StreamSink(std::ostream &Out)
+		{
+			return [&Out](const char *Data, size_t Size)
+			{
+				if(!Out.write(Data, Size))
+					throw CVFSException("Can't write stream.", VFSError::FAILED_TO_WRITE_STREAM);
+			};
+		}
+
+		static CVFSWriter::Sink FdSink(int Fd)
+		{
+			return [Fd](const char *Data, size_t Size)
+			{
+				while (Size != 0)
 				{
-					m_Modified = file.m_Modified;
-					m_Size = file.m_Size;
+#ifdef _WIN32
+					int Written = _write(Fd, Data, (unsigned)std::min(Size, (size_t)INT_MAX));
+#else
+					ssize_t Written = write(Fd, Data, Size);
+					if(Written < 0 && errno == EINTR)
+						continue;
+#endif
+					if(Written <= 0)
+						throw CVFSException("Can't write stream.", VFSError::FAILED_TO_WRITE_STREAM);
+
+					Data += Written;
+					Size -= Written;
+				}
+			};
+		}
 
-					ReserveChunks(file.m_Data.size());
+		//Packed image layout: header block (magic, version, block size), blocks, block index, node table,
+		//subtree table, footer. The node table stores the nodes in pre-order, files reference their blocks by index.
+		//The subtree table holds the node table offset of every root entry, so the subtrees can be decoded in parallel.
+		struct SPackFooter
+		{
+			uint64_t BlockIndexOffset;
+			uint64_t BlockCount;
+			uint64_t NodeTableOffset;
+			uint64_t NodeTableSize;
+			uint64_t RootEntries;
+			uint64_t SubtreeTableOffset;	//0 for images without subtree table.
+			uint64_t HotEnd;	//End of the blocks of SVFSPackOptions::AccessOrder, which follow the header. 0 without.
+			uint64_t Reserved[9];  //Zero, free for extensions.
+		};
 
-					for (size_t i = 0; i < file.m_Data.size(); i++)
-					{
-						Chunk s = file.m_Data[i];
-						Chunk d = m_Data[i];
+		struct SPackedFile
+		{
+			uint64_t Size = 0;
+			std::vector<uint64_t> Ids;
+		};
 
-						d->Filled = s->Filled;
-						memcpy(d->Data, s->Data, s->Filled);
-					}
-				}
+		//Full blocks wait in Pending until a batch is complete, the batch is compressed in parallel
+		//and written in order, so the block ids and the image don't depend on the thread count.
+		struct SPackState
+		{
+			CVFSWriter &Out;
+			uint32_t BlockSize;
+			unsigned Threads = 1;
 
-				void Clear()
-				{
-					std::lock_guard<std::mutex> lock(m_UpdateLock);
-					m_Data.clear();
-					ReserveChunks(4);
-				}
+			std::vector<SVFSBlockEntry> Blocks{};
+			std::vector<char> Nodes{};
+			std::vector<char> Raw{};
+			size_t RawFilled = 0;
 
-				size_t Write(const char *Data, size_t Size)
-				{
-					std::lock_guard<std::mutex> lock(m_UpdateLock);
+			std::vector<std::vector<char>> Pending{};
+			std::vector<size_t> PendingSizes{};
+			std::vector<std::vector<char>> Compressed{};
+			std::vector<size_t> CompressedSizes{};
+			size_t PendingCount = 0;
 
-					size_t ChunkCount = Size / CHUNK_SIZE + ((Size % CHUNK_SIZE > 0) ? 1 : 0);
-					if(((m_Size + Size) >= (m_Data.size() * CHUNK_SIZE)))    //Allocate new chunks, if we are exhausted.
-						ReserveChunks(ChunkCount);
+			bool Dedup = false;
+			std::unordered_map<Hash::SHash128, uint64_t, Hash::SHash128Hasher> Known{};	//Block id by content.
 
-					size_t Written = 0;
-					size_t ChunkPos = m_Size / CHUNK_SIZE;  //Calculates the beginning chunk.
+			std::unordered_map<const CVFSNode*, SPackedFile> Packed{};	//Files stored ahead of the tree.
+		};
 
-					while (Written < Size)
-					{
-						Chunk c = m_Data[ChunkPos];
-						size_t Free = c->Size - c->Filled;
-						size_t CopyCount = ((Size - Written) >= Free) ? Free : (Size - Written);    //Calculate the right copy size.
-
-						memcpy(c->Data + c->Filled, Data + Written, CopyCount);
-						c->Filled += CopyCount; //Chunk update
-						m_Size += CopyCount;  
-						Written += CopyCount;
-						ChunkPos++;
-					}
+		struct SPackedImage
+		{
+			std::shared_ptr<const CMappedImage> Image;
+			const char *Data;
+			std::shared_ptr<const std::vector<SVFSBlockEntry>> Blocks;
+			uint32_t BlockSize;
+		};
 
-					m_Modified = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-					return Written;
-				}
+		template<class T>
+		static void Put(std::vector<char> &Out, const T &Value)
+		{
+			Out.insert(Out.end(), (const char*)&Value, (const char*)&Value + sizeof(T));
+		}
 
-				size_t Read(char *Buf, size_t Size, size_t CurPos)
+		//Queues the collected raw data as a new block and returns its id.
+		//With deduplication a block, which was already emitted, returns the id of the first copy.
+		uint64_t EmitBlock(SPackState &State)
+		{
+			uint64_t Id = State.Blocks.size() + State.PendingCount;
+			if(State.Dedup)
+			{
+				auto Known = State.Known.emplace(Hash::Hash128(State.Raw.data(), State.RawFilled), Id);
+				if(!Known.second)
 				{
-					std::lock_guard<std::mutex> lock(m_UpdateLock);
+					State.RawFilled = 0;
+					return Known.first->second;
+				}
+			}
 
-					size_t ChunkPos = CurPos / CHUNK_SIZE; //Calculates the beginning chunk.
-					size_t Readed = 0;
+			auto &Slot = State.Pending[State.PendingCount];
+			Slot.resize(State.BlockSize);
+			Slot.swap(State.Raw);
+			State.PendingSizes[State.PendingCount++] = State.RawFilled;
+			State.RawFilled = 0;
 
-					while (Readed < Size)
-					{
-						if(ChunkPos >= m_Data.size())
-							break;
+			if(State.PendingCount == State.Pending.size())
+				FlushBlocks(State);
 
-						Chunk c = m_Data[ChunkPos];
-						size_t Pos = CurPos - ChunkPos * CHUNK_SIZE;
-						Pos = (Pos > CHUNK_SIZE) ? 0 : Pos;
+			return Id;
+		}
 
-						int CopyCount = c->Filled - Pos;
-						CopyCount = CopyCount > Size ? Size : CopyCount;    //Calculate the right copy size.
-						if(CopyCount <= 0)
-							break;
+		//Compresses the pending blocks, blocks which don't shrink are stored raw.
+		void FlushBlocks(SPackState &State)
+		{
+			Threads::ThreadPool::Global().ParallelFor(State.PendingCount, [&State](size_t i)
+			{
+				auto &Dst = State.Compressed[i];
+				Dst.resize(LZ::CompressBound(State.BlockSize));
+				State.CompressedSizes[i] = LZ::Compress(State.Pending[i].data(), State.PendingSizes[i], Dst.data(), Dst.size());
+			}, State.Threads);
 
-						memcpy(Buf + Readed, c->Data + Pos, CopyCount);
-						Readed += CopyCount;
-						ChunkPos++;
-					}
-					
-					m_Accessed = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-					return Readed;
-				}
+			for (size_t i = 0; i < State.PendingCount; i++)
+			{
+				SVFSBlockEntry Entry{};
+				Entry.Offset = State.Out.Tell();
+				Entry.RawSize = State.PendingSizes[i];
 
-				inline time_t Modified() const
+				size_t Size = State.CompressedSizes[i];
+				if(Size != 0 && Size < Entry.RawSize)
 				{
-					std::lock_guard<std::mutex> lock(m_UpdateLock);
-					return m_Modified;
+					Entry.StoredSize = Size;
+					Entry.Flags = SVFSBlockEntry::COMPRESSED;
+					State.Out.Write(State.Compressed[i].data(), Size);
 				}
-
-
-				inline size_t Size() const
+				else
 				{
-					std::lock_guard<std::mutex> lock(m_UpdateLock);
-					return m_Size;
+					Entry.StoredSize = Entry.RawSize;
+					State.Out.Write(State.Pending[i].data(), Entry.RawSize);
 				}
 
-				VFSNode Copy() override
-				{
-					return VFSFile(new CVFSFile(*this));
-				}
+				State.Blocks.push_back(Entry);
+			}
 
-			private:
-				struct SChunk
-				{
-					public:
-						SChunk()
-						{
-							Size = CHUNK_SIZE;
-							Filled = 0;
-							Data = new char[Size];
-						}
+			State.PendingCount = 0;
+		}
 
-						int Size;
-						int Filled;
-						char *Data;
+		void PackNode(SPackState &State, CVFSNode *Node)
+		{
+			uint32_t NameSize = Node->m_Name.size();
+			Put(State.Nodes, NameSize);
+			State.Nodes.insert(State.Nodes.end(), Node->m_Name.begin(), Node->m_Name.end());
+			Put(State.Nodes, (uint8_t)Node->m_IsDir);
+			Put(State.Nodes, Node->Created());
+			Put(State.Nodes, Node->Accessed());
 
-						~SChunk()
-						{
-							delete[] Data;
-						}
-				};
+			if(Node->IsDir())
+			{
+				auto Childs = static_cast<CVFSDir*>(Node)->GetChilds();
+				Put(State.Nodes, (uint64_t)Childs.size());
 
-				using Chunk = std::shared_ptr<SChunk>;
+				for (auto e : Childs)
+					PackNode(State, e.get());
+			}
+			else
+			{
+				auto NodeFile = static_cast<CVFSFile*>(Node);
+				Put(State.Nodes, NodeFile->Modified());
 
-				void ReserveChunks(size_t Count)
+				auto Hot = State.Packed.find(Node);
+				SPackedFile File = Hot != State.Packed.end() ? std::move(Hot->second) : PackFile(State, NodeFile);
+				Put(State.Nodes, File.Size);
+				Put(State.Nodes, (uint64_t)File.Ids.size());
+				State.Nodes.insert(State.Nodes.end(), (const char*)File.Ids.data(), (const char*)(File.Ids.data() + File.Ids.size()));
+			}
+		}
+
+		//Stores the data of the file in blocks, the last block isn't shared with the next file.
+		SPackedFile PackFile(SPackState &State, CVFSFile *NodeFile)
+		{
+			SPackedFile Ret;
+			NodeFile->ForEachSegment([&](const char *Data, size_t Count)
+			{
+				Ret.Size += Count;
+				while (Count != 0)
 				{
-					m_Data.reserve(Count);
-					for (size_t i = 0; i < Count; i++)
-						m_Data.push_back(Chunk(new SChunk()));
+					size_t Part = std::min(Count, (size_t)State.BlockSize - State.RawFilled);
+					memcpy(State.Raw.data() + State.RawFilled, Data, Part);
+					State.RawFilled += Part;
+					Data += Part;
+					Count -= Part;
+
+					if(State.RawFilled == State.BlockSize)
+						Ret.Ids.push_back(EmitBlock(State));
 				}
+			});
 
-				time_t m_Modified;
-				size_t m_Size;
+			if(State.RawFilled != 0)
+				Ret.Ids.push_back(EmitBlock(State));
 
-				std::vector<Chunk> m_Data;
-		};
+			return Ret;
+		}
 
-		class CVFSDir : public CVFSNode
+		//Writes a v1 image of the live tree or of a snapshot. Only images of the live tree are journaled.
+		void SerializeImage(const CVFSWriter::Sink &Sink, const CVFSSnapshot *Snapshot)
 		{
-			public:
-				CVFSDir() : CVFSNode()
+			try
+			{
+				CVFSWriter Out(Sink);
+				Out.Write(MAGIC.data(), MAGIC.size());
+
+				//Journaled images store the journal sequence in the header and the node ids in image order
+				//behind the nodes, older readers ignore both.
+				bool Journaled = !Snapshot && m_Changes->Active();
+				auto Childs = NamedChilds(*Root(Snapshot), Snapshot);
+				uint64_t Entries = Childs.size();
+				uint64_t Sequence = Journaled ? m_Changes->m_Sequence : 0;
+				Out.Write(&Entries, sizeof(Entries));
+				Out.Write(&Sequence, sizeof(Sequence));
+				Out.Fill(DISK_CHUNK_SIZE - (MAGIC.size() + sizeof(Entries) + sizeof(Sequence)));
+
+				std::vector<uint64_t> Ids;
+				for (auto &&e : Childs)
+					SerializeNode(Out, e.first, e.second.get(), Journaled ? &Ids : nullptr, Snapshot);
+
+				if(Journaled)
 				{
-					m_IsDir = true;
+					uint64_t Count = Ids.size();
+					uint64_t NextId = m_Changes->m_NextId;
+					Out.Write(NODE_IDS_MAGIC, sizeof(NODE_IDS_MAGIC));
+					Out.Write(&NextId, sizeof(NextId));
+					Out.Write(&Count, sizeof(Count));
+					Out.Write(Ids.data(), Ids.size() * sizeof(uint64_t));
 				}
 
-				CVFSDir(const std::string &Name) : CVFSDir()
-				{
-					m_Name = Name;
-				}
+				Out.Flush();
+			}
+			catch(const std::bad_alloc &e)
+			{
+				throw CVFSException("Can't create stream. Out of mem. bad_alloc: " + std::string(e.what()), VFSError::OUT_OF_MEM);
+			}
+		}
 
-				CVFSDir(const CVFSDir &dir) : CVFSNode(dir)
-				{
-					m_Childs.reserve(dir.m_Childs.size());
-					for (auto &&e : dir.m_Childs)
-					{
-						m_Childs.push_back(e->Copy());
-					}
-				}
+		//Size of the padding, which aligns the next node to DISK_CHUNK_SIZE.
+		size_t BlockPadding(size_t NodeSize) const
+		{
+			return (DISK_CHUNK_SIZE - NodeSize % DISK_CHUNK_SIZE) % DISK_CHUNK_SIZE;
+		}
 
-				void AppendChild(VFSNode Child)
-				{
-					std::lock_guard<std::mutex> lock(m_UpdateLock);
-					InternalAppendChild(Child);
-				}
+		//Childs of the directory and content of the file at the time of the snapshot or the current ones without snapshot.
+		VFSDir Root(const CVFSSnapshot *Snapshot) const;
+		static std::vector<std::pair<std::string, VFSNode>> NamedChilds(CVFSDir &Dir, const CVFSSnapshot *Snapshot);
+		static CVFSFile::SContent Content(CVFSFile &File, const CVFSSnapshot *Snapshot);
 
-				VFSNode Search(const std::string &Name)
-				{
-					std::lock_guard<std::mutex> lock(m_UpdateLock);
-					VFSNode Ret;
+		void SerializeNode(CVFSWriter &Out, const std::string &Name, CVFSNode *Node, std::vector<uint64_t> *Ids, const CVFSSnapshot *Snapshot)
+		{
+			if(Ids)
+				Ids->push_back(Node->m_Id);
 
-					if(!m_Childs.empty())
-					{
-						size_t Pos = Search(Name, 0, m_Childs.size() - 1);
-						if(m_Childs[Pos]->Name() == Name)
-							Ret = m_Childs[Pos];
-					}
+			time_t Created = Node->Created();
+			time_t Accessed = Node->Accessed();
+			size_t NodeSize = NODE_IDENTIFIER.size() + sizeof(int) + (int)Name.size() + sizeof(Node->m_IsDir) + sizeof(Created) + sizeof(Accessed);
+			Out.Write(NODE_IDENTIFIER.data(), NODE_IDENTIFIER.size());
 
-					return Ret;
-				}
+			int NameSize = Name.size();
+			Out.Write(&NameSize, sizeof(int));
+			Out.Write(Name.data(), NameSize);
+			Out.Write(&Node->m_IsDir, sizeof(Node->m_IsDir));
+			Out.Write(&Created, sizeof(Created));
+			Out.Write(&Accessed, sizeof(Accessed));
 
-				void RenameChild(const std::string &Name, const std::string &NewName)
-				{
-					std::lock_guard<std::mutex> lock(m_UpdateLock);
-					size_t Pos = Search(Name, 0, m_Childs.size() - 1);
-					auto Child = m_Childs[Pos];
-					if(Child->Name() == Name)
-					{
-						m_Childs.erase(m_Childs.begin() + Pos); //Removes the child temporary.
-						Child->m_Name = NewName;
+			if(Node->IsDir())
+			{
+				auto Childs = NamedChilds(*static_cast<CVFSDir*>(Node), Snapshot);
 
-						InternalAppendChild(Child);
-					}
-				}
+				uint64_t EntryCount = Childs.size();
+				Out.Write(&EntryCount, sizeof(EntryCount));
 
-				void RemoveChild(const std::string &Name)
-				{
-					std::lock_guard<std::mutex> lock(m_UpdateLock);
-					size_t Pos = Search(Name, 0, m_Childs.size() - 1);
-					auto Child = m_Childs[Pos];
-					if(Child->Name() == Name)
-						m_Childs.erase(m_Childs.begin() + Pos); //Removes the child.
-				}
+				Out.Fill(BlockPadding(NodeSize + sizeof(uint64_t)));
+				for (auto &&e : Childs)
+					SerializeNode(Out, e.first, e.second.get(), Ids, Snapshot);
+			}
+			else
+			{
+				auto NodeFile = Content(*static_cast<CVFSFile*>(Node), Snapshot);  //Size and data stay consistent with concurrent writes.
 
-				std::vector<VFSNode> GetChilds()
+				time_t mtime = NodeFile.Modified;
+				Out.Write(&mtime, sizeof(mtime));
+
+				uint64_t Size = NodeFile.Size;
+				Out.Write(&Size, sizeof(Size));
+
+				NodeSize += sizeof(mtime) + sizeof(Size);
+
+				size_t FillSize = BlockPadding(NodeSize);
+				auto WriteSegment = [&Out](const char *Data, size_t Count) { Out.Write(Data, Count); };
+				if(Size <= FillSize)    //Small files are stored inside the node block.
 				{
-					std::lock_guard<std::mutex> lock(m_UpdateLock);
-					m_Accessed = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-					return m_Childs;
+					NodeFile.ForEachSegment(WriteSegment);
+					Out.Fill(FillSize - Size);
 				}
-
-				VFSNode Copy() override
+				else
 				{
-					return VFSDir(new CVFSDir(*this));
+					Out.Fill(FillSize);
+					NodeFile.ForEachSegment(WriteSegment);
+					Out.Fill(BlockPadding(Size));
 				}
+			}
+		}
 
-			private:
-				size_t Search(const std::string &Name, size_t Start, size_t End)
-				{
-					if(End < Start || End == (size_t) -1)
-						return 0;
-					else if(End == Start)
-						return End;
+		struct SImageReader
+		{
+			const char *Data;
+			size_t Size;
+			size_t Pos;
 
-					size_t Middle = Start + (End - Start) / 2;
-					std::string PosName = m_Childs[Middle]->Name();
-					if(PosName == Name)
-						return Middle;
-					else if(Name > PosName)
-						return Search(Name, Middle + 1, End);
-					else if(Name < PosName)
-						return Search(Name, Start, Middle - 1);
+			//Returns the next Count bytes of the image.
+			const char *Region(size_t Count)
+			{
+				if(Pos > Size || Count > Size - Pos)
+					throw CVFSException("Can't create filesystem.", VFSError::FAILED_TO_READ_STREAM);
 
-					return Middle;                        
-				}
+				const char *Ret = Data + Pos;
+				Pos += Count;
+				return Ret;
+			}
 
-				void InternalAppendChild(VFSNode Child)
-				{
-					size_t Pos = 0;
+			void Read(void *Buf, size_t Count)
+			{
+				const char *Src = Region(Count);
+				if(Count != 0)
+					memcpy(Buf, Src, Count);
+			}
+		};
 
-					for (Pos = 0; Pos < m_Childs.size(); Pos++)
-					{
-						if(Child->Name() < m_Childs[Pos]->Name())
-							break;
-					}
-					
-					m_Childs.insert(m_Childs.begin() + Pos, Child);
-				}
+		//A journal is a sequence of segments, one per save. Each segment starts with this header and
+		//holds the records of the save, see JournalRecord.
+		struct SJournalHeader
+		{
+			char Magic[4];
+			uint32_t Version;
+			uint64_t Sequence;
+			uint64_t Size;		//Bytes of the records.
+			uint64_t Checksum;	//XXH64 of the records.
+		};
 
-				std::vector<VFSNode> m_Childs;
+		//Records start with the type, nodes are referred by their id and names are stored with a uint32_t size.
+		enum class JournalRecord : uint8_t
+		{
+			DIR = 1,	//Id, parent id, created, name
+			FILE,		//Id, parent id, created, name
+			REMOVE,		//Parent id, name
+			RENAME,		//Parent id, name, new name
+			MOVE,		//Parent id, name, new parent id
+			DATA		//Id, flags, offset, modified, size, data
 		};
 
-		std::vector<std::string> SplitPath(const std::string &Path)
+		static constexpr uint8_t JOURNAL_TRUNCATE = 1;
+
+		static void PutName(std::vector<char> &Out, std::string_view Name)
 		{
-			size_t Pos = 0;
-			std::vector<std::string> Ret;
+			Put(Out, (uint32_t)Name.size());
+			Out.insert(Out.end(), Name.begin(), Name.end());
+		}
 
-			if(!Path.empty() && Path[0] == '/')
-				Pos++;
+		static std::string ReadName(SImageReader &In)
+		{
+			uint32_t Size;
+			In.Read(&Size, sizeof(Size));
+			return std::string(In.Region(Size), Size);
+		}
+
+		//Gives nodes without id, e.g. mounted ones, a new id and resets the journal state of the files.
+		void NumberNodes(const VFSNode &Node, std::unordered_map<uint64_t, std::weak_ptr<CVFSNode>> *Nodes)
+		{
+			if(Node == m_Root)
+				Node->m_Id = ROOT_ID;
+			else if(Node->m_Id == 0)
+				Node->m_Id = m_Changes->m_NextId++;
+
+			if(Nodes)
+				(*Nodes)[Node->m_Id] = Node;
+
+			if(Node->IsDir())
+			{
+				for (auto &&e : static_cast<CVFSDir*>(Node.get())->GetChilds())
+					NumberNodes(e, Nodes);
+			}
+			else
+				ResetSaveState(static_cast<CVFSFile&>(*Node));
+		}
+
+		static void ResetSaveState(CVFSFile &File)
+		{
+			std::lock_guard<std::shared_mutex> lock(File.m_UpdateLock);
+			File.m_SavedSize = File.m_Size;
+			File.m_Truncated = false;
+			File.m_Dirty = false;
+		}
+
+		//Records a new node, copied directories with their content. Files are empty at first,
+		//copied files are queued, so the next save stores their data.
+		void RecordNode(const VFSNode &Node, const VFSNode &Parent)
+		{
+			if(!m_Changes->Active())
+				return;
+
+			{
+				std::lock_guard<std::mutex> lock(m_Changes->m_Lock);
+				if(Parent->m_Id == 0)
+					return;
+
+				RecordTree(Node, Parent->m_Id);
+			}
+
+			QueueFiles(Node);
+		}
+
+		void RecordTree(const VFSNode &Node, uint64_t Parent)
+		{
+			Node->m_Id = m_Changes->m_NextId++;
+
+			auto &Out = m_Changes->m_Records;
+			Put(Out, Node->IsDir() ? JournalRecord::DIR : JournalRecord::FILE);
+			Put(Out, Node->m_Id);
+			Put(Out, Parent);
+			Put(Out, Node->Created());
+			PutName(Out, Node->m_Name);
+
+			if(Node->IsDir())
+			{
+				for (auto &&e : static_cast<CVFSDir*>(Node.get())->GetChilds())
+					RecordTree(e, Node->m_Id);
+			}
+		}
+
+		void QueueFiles(const VFSNode &Node)
+		{
+			if(Node->IsDir())
+			{
+				for (auto &&e : static_cast<CVFSDir*>(Node.get())->GetChilds())
+					QueueFiles(e);
+			}
+			else
+			{
+				auto &File = static_cast<CVFSFile&>(*Node);
+				std::lock_guard<std::shared_mutex> lock(File.m_UpdateLock);
+				if(File.m_Size != 0)
+					File.MarkDirty();
+			}
+		}
+
+		//Ids are read and cleared under the lock of the change log, so a node leaves the journal together with its record.
+		void RecordRemove(const VFSDir &Parent, std::string_view Name, const VFSNode &Node)
+		{
+			if(!m_Changes->Active())
+				return;
+
+			std::lock_guard<std::mutex> lock(m_Changes->m_Lock);
+			if(Parent->m_Id == 0)
+				return;
+
+			Put(m_Changes->m_Records, JournalRecord::REMOVE);
+			Put(m_Changes->m_Records, Parent->m_Id);
+			PutName(m_Changes->m_Records, Name);
+			DetachTree(Node);
+		}
+
+		//Removed nodes can live on in streams and views. They lose their ids, so later writes to them and new
+		//nodes in them aren't journaled, a replay couldn't find them after the removal.
+		void DetachTree(const VFSNode &Node)
+		{
+			Node->m_Id = 0;
+			if(Node->IsDir())
+			{
+				for (auto &&e : static_cast<CVFSDir*>(Node.get())->GetChilds())
+					DetachTree(e);
+			}
+		}
+
+		void RecordRename(const VFSDir &Parent, std::string_view Name, std::string_view NewName)
+		{
+			if(!m_Changes->Active())
+				return;
+
+			std::lock_guard<std::mutex> lock(m_Changes->m_Lock);
+			if(Parent->m_Id == 0)
+				return;
 
-			while (Pos != std::string::npos)
+			Put(m_Changes->m_Records, JournalRecord::RENAME);
+			Put(m_Changes->m_Records, Parent->m_Id);
+			PutName(m_Changes->m_Records, Name);
+			PutName(m_Changes->m_Records, NewName);
+		}
+
+		//Moves out of or into directories, which aren't journaled, are recorded as removal.
+		void RecordMove(const VFSDir &Parent, std::string_view Name, const VFSNode &Node, const VFSDir &NewParent)
+		{
+			if(!m_Changes->Active())
+				return;
+
+			std::lock_guard<std::mutex> lock(m_Changes->m_Lock);
+			if(Parent->m_Id == 0)
+				return;
+
+			Put(m_Changes->m_Records, NewParent->m_Id != 0 ? JournalRecord::MOVE : JournalRecord::REMOVE);
+			Put(m_Changes->m_Records, Parent->m_Id);
+			PutName(m_Changes->m_Records, Name);
+			if(NewParent->m_Id != 0)
+				Put(m_Changes->m_Records, NewParent->m_Id);
+			else
+				DetachTree(Node);
+		}
+
+		//Appends the data written since the last save. The data is taken as view under the lock,
+		//so the record matches the state of the file at one point in time.
+		//A file removed from the tree has no id anymore and only its save state is reset. If it was removed after
+		//the records of this save were taken, its data still comes before the removal in the journal.
+		void JournalData(std::vector<char> &Out, CVFSFile &File)
+		{
+			uint64_t Id;
+			{
+				std::lock_guard<std::mutex> lock(m_Changes->m_Lock);
+				Id = File.m_Id;
+			}
+
+			CVFSView Data;
+			uint8_t Flags;
+			uint64_t Offset;
+			time_t Modified;
 			{
-				size_t Start = Pos;
-				Pos = Path.find('/', Start);
+				std::lock_guard<std::shared_mutex> lock(File.m_UpdateLock);
+				Flags = File.m_Truncated ? JOURNAL_TRUNCATE : 0;
+				Offset = File.m_SavedSize;
+				Modified = File.m_Modified;
+				File.InternalView(Offset, SIZE_MAX, Data);
+
+				File.m_SavedSize = File.m_Size;
+				File.m_Truncated = false;
+				File.m_Dirty = false;
+			}
 
-				std::string Dir = Path.substr(Start, Pos - Start);
-				
-				if(!Dir.empty())
-					Ret.push_back(Dir);
+			if(Id == 0)
+				return;
 
-				if(Pos != std::string::npos)
-					Pos++;
-			}
-			
-			return Ret;
+			Put(Out, JournalRecord::DATA);
+			Put(Out, Id);
+			Put(Out, Flags);
+			Put(Out, Offset);
+			Put(Out, Modified);
+			Put(Out, (uint64_t)Data.Size());
+			for (auto &&e : Data)
+				Out.insert(Out.end(), e.begin(), e.end());
 		}
 
-		std::string ExtractPath(const std::string &Path)
+		static VFSNode ReplayNode(const std::unordered_map<uint64_t, std::weak_ptr<CVFSNode>> &Nodes, uint64_t Id)
 		{
-			size_t Pos = Path.find_last_of("/");
-			if(Pos == Path.length() - 1)
-				Pos = Path.find_last_of("/", Pos - 1);
+			auto It = Nodes.find(Id);
+			VFSNode Ret = It != Nodes.end() ? It->second.lock() : nullptr;
+			if(!Ret)
+				throw CVFSException("Can't replay journal. Invalid node id.", VFSError::CANT_CREATE_FILESYSTEM);
 
-			return Path.substr(0, Pos);
+			return Ret;
 		}
 
-		std::string ExtractName(const std::string &Path)
+		static VFSDir ReplayDir(const std::unordered_map<uint64_t, std::weak_ptr<CVFSNode>> &Nodes, SImageReader &In)
 		{
-			size_t End = std::string::npos;
-			size_t Pos = Path.find_last_of("/");
-			if(Pos == Path.length() - 1)
-			{
-				End = Pos - 1;
-				Pos = Path.find_last_of("/", Pos - 1);
-			}
+			uint64_t Id;
+			In.Read(&Id, sizeof(Id));
+			auto Node = ReplayNode(Nodes, Id);
+			if(!Node->IsDir())
+				throw CVFSException("Can't replay journal. Node is a file.", VFSError::NODE_IS_FILE);
 
-			return Path.substr(Pos + 1, End - Pos);
+			return std::static_pointer_cast<CVFSDir>(Node);
 		}
 
-		void FillSpace(CVFSFile *file, size_t Count)
+		void ReplayRecord(SImageReader &In, std::unordered_map<uint64_t, std::weak_ptr<CVFSNode>> &Nodes)
 		{
-			for (size_t i = 0; i < Count; i++)
+			JournalRecord Type;
+			In.Read(&Type, sizeof(Type));
+			switch (Type)
 			{
-				char c = 0;
-				file->Write(&c, sizeof(c));
+				case JournalRecord::DIR:
+				case JournalRecord::FILE:
+				{
+					uint64_t Id;
+					time_t Created;
+					In.Read(&Id, sizeof(Id));
+					auto Parent = ReplayDir(Nodes, In);
+					In.Read(&Created, sizeof(Created));
+					std::string Name = ReadName(In);
+
+					if(Id == 0 || Nodes.count(Id) || Parent->Search(Name))
+						throw CVFSException("Can't replay journal. Node already exists.", VFSError::NODE_ALREADY_EXISTS);
+
+					VFSNode Node;
+					if(Type == JournalRecord::DIR)
+						Node = NewDir(Name);
+					else
+						Node = NewFile(Name);
+
+					Node->m_Id = Id;
+					Node->m_Created = Created;
+					Parent->AppendChild(Node);
+					Nodes[Id] = Node;
+					m_Changes->m_NextId = std::max(m_Changes->m_NextId, Id + 1);
+				} break;
+
+				case JournalRecord::REMOVE:
+				{
+					auto Parent = ReplayDir(Nodes, In);
+					Parent->RemoveChild(ReadName(In));
+					InvalidatePaths();
+				} break;
+
+				case JournalRecord::RENAME:
+				{
+					auto Parent = ReplayDir(Nodes, In);
+					std::string Name = ReadName(In);
+					std::string NewName = ReadName(In);
+					Parent->RenameChild(Name, NewName);
+					InvalidatePaths();
+				} break;
+
+				case JournalRecord::MOVE:
+				{
+					auto Parent = ReplayDir(Nodes, In);
+					std::string Name = ReadName(In);
+					auto NewParent = ReplayDir(Nodes, In);
+					if(auto Node = Parent->Search(Name))
+					{
+						Parent->RemoveChild(Name);
+						NewParent->AppendChild(Node);
+						InvalidatePaths();
+					}
+				} break;
+
+				case JournalRecord::DATA:
+				{
+					uint64_t Id;
+					uint8_t Flags;
+					uint64_t Offset;
+					time_t Modified;
+					uint64_t Size;
+					In.Read(&Id, sizeof(Id));
+					In.Read(&Flags, sizeof(Flags));
+					In.Read(&Offset, sizeof(Offset));
+					In.Read(&Modified, sizeof(Modified));
+					In.Read(&Size, sizeof(Size));
+					const char *Data = In.Region(Size);
+
+					//Journals of older versions could store the data of files removed earlier in the same segment.
+					auto It = Nodes.find(Id);
+					if(It != Nodes.end() && It->second.expired())
+						break;
+
+					auto Node = ReplayNode(Nodes, Id);
+					if(Node->IsDir())
+						throw CVFSException("Can't replay journal. Node is a directory.", VFSError::NODE_IS_DIR);
+
+					auto &File = static_cast<CVFSFile&>(*Node);
+					if(Flags & JOURNAL_TRUNCATE)
+						File.Clear();
+
+					if(File.Size() != Offset)
+						throw CVFSException("Can't replay journal. The journal doesn't match the image.", VFSError::CANT_CREATE_FILESYSTEM);
+
+					File.Write(Data, Size);
+					File.m_Modified = Modified;
+					ResetSaveState(File);
+				} break;
+
+				default:
+					throw CVFSException("Can't replay journal. Unknown record.", VFSError::CANT_CREATE_FILESYSTEM);
 			}
 		}
-		
-		void SerializeNode(CVFSFile *file, CVFSNode *Node)
-		{
-			size_t NodeSize = NODE_IDENTIFIER.size() + sizeof(int) + (int)Node->m_Name.size() + sizeof(Node->m_IsDir) + sizeof(Node->m_Created) + sizeof(Node->m_Accessed);
-			file->Write(NODE_IDENTIFIER.data(), NODE_IDENTIFIER.size());
-
-			int NameSize = Node->m_Name.size();
-			file->Write((char*)&NameSize, sizeof(int));
-			file->Write(Node->m_Name.data(), NameSize);
-			file->Write((char*)&Node->m_IsDir, sizeof(Node->m_IsDir));
-			file->Write((char*)&Node->m_Created, sizeof(Node->m_Created));
-			file->Write((char*)&Node->m_Accessed, sizeof(Node->m_Accessed));
 
-			if(Node->IsDir())
+		void DeserializeImage(SImageReader &In, const std::shared_ptr<const CMappedImage> &Image)
+		{
+			try
 			{
-				auto Dir = static_cast<CVFSDir*>(Node);
-				auto Childs = Dir->GetChilds();
+				uint64_t Entries = 0;
+				if(In.Size >= PACK_MAGIC.size() && memcmp(In.Data, PACK_MAGIC.data(), PACK_MAGIC.size()) == 0)
+				{
+					In.Pos += PACK_MAGIC.size();
+					DeserializePacked(In, Image);
+					return;
+				}
 
-				uint64_t EntryCount = Childs.size();
-				file->Write((char*)&EntryCount, sizeof(EntryCount));
+				if(In.Size < MAGIC.size() || memcmp(In.Region(MAGIC.size()), MAGIC.data(), MAGIC.size()) != 0)
+					throw CVFSException("Can't create filesystem.", VFSError::CANT_CREATE_FILESYSTEM);
 
-				int FillSize = DISK_CHUNK_SIZE - (NodeSize + sizeof(uint64_t));
-				FillSpace(file, FillSize);
-				for (auto e : Childs)
-					SerializeNode(file, e.get());
-			}
-			else
-			{
-				auto NodeFile = static_cast<CVFSFile*>(Node);
+				uint64_t Sequence = 0;
+				In.Read(&Entries, sizeof(Entries));
+				In.Read(&Sequence, sizeof(Sequence));
+				m_Changes->m_Sequence = Sequence;
 
-				time_t mtime = NodeFile->Modified();
-				file->Write((char*)&mtime, sizeof(mtime));
+				In.Pos += (DISK_CHUNK_SIZE - (MAGIC.size() + sizeof(Entries) + sizeof(Sequence)));
 
-				uint64_t Size = NodeFile->Size();
-				file->Write((char*)&Size, sizeof(Size));
+				std::vector<VFSNode> Nodes;
+				for (size_t i = 0; i < Entries; i++)
+					Nodes.push_back(DeserializeNode(In, Image));
 
-				NodeSize += sizeof(mtime) + sizeof(Size);
+				m_Root->AppendChildren(Nodes);
 
-				int FillSize = DISK_CHUNK_SIZE - (NodeSize > DISK_CHUNK_SIZE ? (NodeSize - DISK_CHUNK_SIZE) : NodeSize);
-				if(NodeFile->Size() <= FillSize)
+				if(In.Size - In.Pos >= sizeof(NODE_IDS_MAGIC) && memcmp(In.Data + In.Pos, NODE_IDS_MAGIC, sizeof(NODE_IDS_MAGIC)) == 0 && !m_Changes->Active())
 				{
-					file->Write(NodeFile->m_Data[0]->Data, NodeFile->m_Data[0]->Filled);
-					FillSize -= NodeFile->Size();
-				}
+					In.Pos += sizeof(NODE_IDS_MAGIC);
+					uint64_t NextId, Count;
+					In.Read(&NextId, sizeof(NextId));
+					In.Read(&Count, sizeof(Count));
+					if(Count > (In.Size - In.Pos) / sizeof(uint64_t))
+						throw CVFSException("Can't create filesystem. Invalid node ids.", VFSError::CANT_CREATE_FILESYSTEM);
+
+					const char *Ids = In.Region(Count * sizeof(uint64_t));
+					size_t Pos = 0;
+					for (auto &&e : Nodes)
+						AssignIds(e, Ids, Count, Pos);
 
-				FillSpace(file, FillSize);
-				if(NodeFile->Size() > FillSize)
-				{
-					FillSize = DISK_CHUNK_SIZE - (NodeFile->Size() % DISK_CHUNK_SIZE);
+					if(Pos != Count)
+						throw CVFSException("Can't create filesystem. Invalid node ids.", VFSError::CANT_CREATE_FILESYSTEM);
 
-					for (auto e : NodeFile->m_Data)
-					{
-						if(e->Filled == 0)
-							break;
+					m_Changes->m_NextId = std::max(m_Changes->m_NextId, NextId);
+				}
+			}
+			catch(const std::bad_alloc &e)
+			{
+				throw CVFSException("Can't create filesystem. Out of mem. bad_alloc: " + std::string(e.what()), VFSError::OUT_OF_MEM);
+			}
+		}
 
-						file->Write(e->Data, e->Filled);
-					}
+		//Assigns the ids stored by a checkpoint, the nodes are visited in image order.
+		static void AssignIds(const VFSNode &Node, const char *Ids, size_t Count, size_t &Pos)
+		{
+			if(Pos == Count)
+				throw CVFSException("Can't create filesystem. Invalid node ids.", VFSError::CANT_CREATE_FILESYSTEM);
 
-					if(FillSize < DISK_CHUNK_SIZE)
-						FillSpace(file, FillSize);
-				}
+			memcpy(&Node->m_Id, Ids + Pos++ * sizeof(uint64_t), sizeof(uint64_t));
+			if(Node->IsDir())
+			{
+				for (auto &&e : static_cast<CVFSDir*>(Node.get())->GetChilds())
+					AssignIds(e, Ids, Count, Pos);
 			}
 		}
 
-		VFSNode DeserializeNode(const std::vector<char> &Data, size_t &Pos)
+		VFSNode DeserializeNode(SImageReader &In, const std::shared_ptr<const CMappedImage> &Image)
 		{
-			std::string Identifier(NODE_IDENTIFIER.size(), '\0');
-			ReadVector(Data, &Identifier[0], Identifier.size(), Pos);
-			if(Identifier != NODE_IDENTIFIER)
+			if(memcmp(In.Region(NODE_IDENTIFIER.size()), NODE_IDENTIFIER.data(), NODE_IDENTIFIER.size()) != 0)
 				throw CVFSException("Invalied node identifier!", VFSError::CANT_CREATE_FILESYSTEM);
 
 			int NameSize = 0;
-			ReadVector(Data, (char*)&NameSize, sizeof(NameSize), Pos); 
+			In.Read(&NameSize, sizeof(NameSize));
+			if(NameSize < 0)
+				throw CVFSException("Invalied node name!", VFSError::CANT_CREATE_FILESYSTEM);
 
-			std::string Name(NameSize, '\0');
-			ReadVector(Data, &Name[0], Name.size(), Pos);
+			std::string Name(In.Region(NameSize), NameSize);
 
 			bool IsDir;
-			ReadVector(Data, (char*)&IsDir, sizeof(IsDir), Pos); 
+			In.Read(&IsDir, sizeof(IsDir));
 
 			time_t Created;
 			time_t Accessed;
-			ReadVector(Data, (char*)&Created, sizeof(Created), Pos); 
-			ReadVector(Data, (char*)&Accessed, sizeof(Accessed), Pos); 
+			In.Read(&Created, sizeof(Created));
+			In.Read(&Accessed, sizeof(Accessed));
 
 			if(IsDir)
 			{
-				auto Dir = VFSDir(new CVFSDir(Name));
+				auto Dir = NewDir(Name);
 				Dir->m_Created = Created;
 				Dir->m_Accessed = Accessed;
 
 				uint64_t Entries = 0;
-				ReadVector(Data, (char*)&Entries, sizeof(Entries), Pos); 
+				In.Read(&Entries, sizeof(Entries));
 
-				size_t NodeSize = NODE_IDENTIFIER.size() + sizeof(int) + (int)Dir->m_Name.size() + sizeof(Dir->m_IsDir) + sizeof(Dir->m_Created) + sizeof(Dir->m_Accessed) + sizeof(uint64_t);
+				size_t NodeSize = NODE_IDENTIFIER.size() + sizeof(int) + (int)Dir->m_Name.size() + sizeof(Dir->m_IsDir) + sizeof(Created) + sizeof(Accessed) + sizeof(uint64_t);
 
-				Pos += DISK_CHUNK_SIZE - NodeSize;
+				In.Pos += BlockPadding(NodeSize);
 
+				std::vector<VFSNode> Childs;
 				for (size_t i = 0; i < Entries; i++)
-					Dir->AppendChild(DeserializeNode(Data, Pos));
+					Childs.push_back(DeserializeNode(In, Image));
+
+				Dir->AppendChildren(Childs);
 		
 				return Dir;
 			}
 			else
 			{
-				auto File = VFSFile(new CVFSFile(Name));
+				auto File = NewFile(Name);
 
 				time_t mtime;
-				ReadVector(Data, (char*)&mtime, sizeof(mtime), Pos); 
+				In.Read(&mtime, sizeof(mtime));
 
 				File->m_Created = Created;
 				File->m_Accessed = Accessed;
 				File->m_Modified = mtime;
 
 				uint64_t Size;
-				ReadVector(Data, (char*)&Size, sizeof(Size), Pos);
+				In.Read(&Size, sizeof(Size));
 
-				size_t NodeSize = NODE_IDENTIFIER.size() + sizeof(int) + (int)File->m_Name.size() + sizeof(File->m_IsDir) + sizeof(File->m_Created) + sizeof(File->m_Accessed) + sizeof(mtime) + sizeof(Size);
-				int FillSize = DISK_CHUNK_SIZE - (NodeSize > DISK_CHUNK_SIZE ? (NodeSize - DISK_CHUNK_SIZE) : NodeSize);
+				size_t NodeSize = NODE_IDENTIFIER.size() + sizeof(int) + (int)File->m_Name.size() + sizeof(File->m_IsDir) + sizeof(Created) + sizeof(Accessed) + sizeof(mtime) + sizeof(Size);
+				size_t FillSize = BlockPadding(NodeSize);
 
 				if(Size > FillSize)
-					Pos += FillSize;
+					In.Pos += FillSize;
 
-				std::string Buf(Size, '\0');
-				ReadVector(Data, &Buf[0], Buf.size(), Pos);
-				File->Write(Buf.data(), Buf.size());
+				const char *Payload = In.Region(Size);
+				if(Image)   //Only the node headers are read, the payload stays inside the mapping.
+				{
+					File->m_Backing = std::make_shared<CVFSMappedRegion>(Image, Payload, Size);
+					File->m_Size = Size;
+				}
+				else
+					File->Write(Payload, Size);
 
 				if(Size <= FillSize)
-					Pos += FillSize - Size;
+					In.Pos += FillSize - Size;
 				else
-					Pos += DISK_CHUNK_SIZE - (Size % DISK_CHUNK_SIZE);
+					In.Pos += BlockPadding(Size);
 
 				return File;
 			}
 		}
 
+		void DeserializePacked(SImageReader &In, const std::shared_ptr<const CMappedImage> &Image)
+		{
+			uint32_t Version = 0;
+			uint32_t BlockSize = 0;
+			In.Read(&Version, sizeof(Version));
+			In.Read(&BlockSize, sizeof(BlockSize));
+			if(Version != PACK_VERSION || BlockSize == 0 || In.Size < sizeof(SPackFooter))
+				throw CVFSException("Can't create filesystem. Unsupported image.", VFSError::CANT_CREATE_FILESYSTEM);
+
+			SPackFooter Footer;
+			memcpy(&Footer, In.Data + In.Size - sizeof(Footer), sizeof(Footer));
+
+			if(Footer.BlockCount > In.Size / sizeof(SVFSBlockEntry))
+				throw CVFSException("Can't create filesystem.", VFSError::FAILED_TO_READ_STREAM);
+
+			auto Blocks = std::make_shared<std::vector<SVFSBlockEntry>>(Footer.BlockCount);
+			SImageReader Index{In.Data, In.Size, Footer.BlockIndexOffset};
+			Index.Read(Blocks->data(), Blocks->size() * sizeof(SVFSBlockEntry));
+
+			for (auto &&e : *Blocks)
+			{
+				if(e.Offset > In.Size || e.StoredSize > In.Size - e.Offset || e.RawSize > BlockSize)
+					throw CVFSException("Can't create filesystem. Invalid block.", VFSError::FAILED_TO_READ_STREAM);
+			}
+
+			//The startup files are read first, so their blocks are fetched in one sequential read ahead of time.
+			if(Image && m_Options.Readahead && Footer.HotEnd != 0 && Footer.HotEnd <= Footer.BlockIndexOffset)
+				Image->Prefetch(0, Footer.HotEnd);
+
+			SImageReader Table{In.Data, In.Size, Footer.NodeTableOffset};
+			Table = SImageReader{Table.Region(Footer.NodeTableSize), Footer.NodeTableSize, 0};
+
+			SPackedImage Packed{Image, In.Data, Blocks, BlockSize};
+			if(Footer.SubtreeTableOffset == 0)
+			{
+				std::vector<VFSNode> Childs;
+				for (size_t i = 0; i < Footer.RootEntries; i++)
+					Childs.push_back(DeserializePackedNode(Table, Packed));
+
+				m_Root->AppendChildren(Childs);
+
+				return;
+			}
+
+			if(Footer.RootEntries > In.Size / sizeof(uint64_t))
+				throw CVFSException("Can't create filesystem.", VFSError::FAILED_TO_READ_STREAM);
+
+			std::vector<uint64_t> Subtrees(Footer.RootEntries + 1);
+			SImageReader SubtreeTable{In.Data, In.Size, Footer.SubtreeTableOffset};
+			SubtreeTable.Read(Subtrees.data(), Footer.RootEntries * sizeof(uint64_t));
+			Subtrees.back() = Footer.NodeTableSize;
+
+			for (size_t i = 0; i < Footer.RootEntries; i++)
+			{
+				if(Subtrees[i] > Subtrees[i + 1] || (i == 0 && Subtrees[i] != 0))
+					throw CVFSException("Can't create filesystem. Invalid subtree table.", VFSError::FAILED_TO_READ_STREAM);
+			}
+
+			//Every root entry is decoded from its own slice of the node table, the results are attached in order.
+			std::vector<VFSNode> Childs(Footer.RootEntries);
+			Threads::ThreadPool::Global().ParallelFor(Childs.size(), [&](size_t i)
+			{
+				SImageReader Subtree{Table.Data + Subtrees[i], Subtrees[i + 1] - Subtrees[i], 0};
+				Childs[i] = DeserializePackedNode(Subtree, Packed);
+				if(Subtree.Pos != Subtree.Size)
+					throw CVFSException("Can't create filesystem. Invalid subtree table.", VFSError::FAILED_TO_READ_STREAM);
+			});
+
+			m_Root->AppendChildren(Childs);
+		}
+
+		VFSNode DeserializePackedNode(SImageReader &In, const SPackedImage &Packed)
+		{
+			uint32_t NameSize = 0;
+			In.Read(&NameSize, sizeof(NameSize));
+			std::string Name(In.Region(NameSize), NameSize);
+
+			uint8_t IsDir;
+			time_t Created;
+			time_t Accessed;
+			In.Read(&IsDir, sizeof(IsDir));
+			In.Read(&Created, sizeof(Created));
+			In.Read(&Accessed, sizeof(Accessed));
+
+			if(IsDir)
+			{
+				auto Dir = NewDir(Name);
+				Dir->m_Created = Created;
+				Dir->m_Accessed = Accessed;
+
+				uint64_t Entries = 0;
+				In.Read(&Entries, sizeof(Entries));
+				std::vector<VFSNode> Childs;
+				for (size_t i = 0; i < Entries; i++)
+					Childs.push_back(DeserializePackedNode(In, Packed));
+
+				Dir->AppendChildren(Childs);
+
+				return Dir;
+			}
+
+			auto File = NewFile(Name);
+			File->m_Created = Created;
+			File->m_Accessed = Accessed;
+			time_t Modified;
+			In.Read(&Modified, sizeof(Modified));
+			File->m_Modified = Modified;
+
+			uint64_t Size = 0;
+			uint64_t Count = 0;
+			In.Read(&Size, sizeof(Size));
+			In.Read(&Count, sizeof(Count));
+			if(Count > (In.Size - In.Pos) / sizeof(uint64_t))
+				throw CVFSException("Can't create filesystem.", VFSError::FAILED_TO_READ_STREAM);
+
+			std::vector<uint64_t> Ids(Count);
+			In.Read(Ids.data(), Count * sizeof(uint64_t));
+
+			//Every block except the last one has to be full, reads locate the blocks by position.
+			uint64_t Total = 0;
+			for (size_t i = 0; i < Ids.size(); i++)
+			{
+				if(Ids[i] >= Packed.Blocks->size() || (i + 1 < Ids.size() && (*Packed.Blocks)[Ids[i]].RawSize != Packed.BlockSize))
+					throw CVFSException("Can't create filesystem. Invalid block reference.", VFSError::FAILED_TO_READ_STREAM);
+
+				Total += (*Packed.Blocks)[Ids[i]].RawSize;
+			}
+
+			if(Total != Size)
+				throw CVFSException("Can't create filesystem. Invalid file size.", VFSError::FAILED_TO_READ_STREAM);
+
+			if(Packed.Image)
+			{
+				File->m_Backing = std::make_shared<CVFSBlockRegion>(Packed.Image, Packed.Blocks, std::move(Ids), Size, Packed.BlockSize);
+				File->m_Size = Size;
+			}
+			else
+			{
+				std::vector<char> Buf(Packed.BlockSize);
+				for (auto Id : Ids)
+				{
+					const SVFSBlockEntry &Entry = (*Packed.Blocks)[Id];
+					CVFSBlockRegion::Decode(Packed.Data, Entry, Buf.data());
+					File->Write(Buf.data(), Entry.RawSize);
+				}
+			}
+
+			return File;
+		}
+
+		SVFSOptions m_Options;
 		VFSDir m_Root;
+		std::shared_ptr<CVFSChunkPool> m_Pool;
+		std::shared_ptr<CVFSChunkStore> m_Store;
+		std::shared_ptr<CVFSContentCache> m_Cache;
+		std::shared_ptr<CVFSChangeLog> m_Changes;
+		std::shared_ptr<CVFSSnapshotList> m_Snapshots;
+		std::shared_mutex m_TreeLock;   //Held shared by changes of several nodes, so snapshots see them completely or not at all.
+
+		std::unordered_map<size_t, SPathCacheEntry> m_PathCache;
+		uint64_t m_Generation = 0;
+		std::shared_mutex m_CacheLock;
+
+		std::atomic<bool> m_LogAccess{false};
+		std::vector<VFSNode> m_AccessLog;   //Files in the order of their first read access.
+		std::unordered_set<const CVFSNode*> m_AccessLogged;
+		std::mutex m_AccessLock;
 };
 
 class CVFSFileStream
 {
 	public:
-		CVFSFileStream(CVFS::VFSFile file, FileMode mode) : m_File(file), m_Mode(mode), m_CurPos(0)
+		CVFSFileStream(CVFS::VFSFile file, FileMode mode, bool UpdateAccess = true) : m_File(file), m_Mode(mode), m_CurPos(0), m_UpdateAccess(UpdateAccess)
 		{
-			if((mode & FileMode::APPEND) != FileMode::APPEND)
+			if((mode & (FileMode::WRITE | FileMode::APPEND)) == FileMode::WRITE)  //Truncates the file, reading keeps it untouched.
 				m_File->Clear();
 		}
 
@@ -904,17 +3661,118 @@ class CVFSFileStream
 
 		std::string ReadLine()
 		{
-			std::string Ret;
-			char c;
-			while (Read(&c, sizeof(c)) != 0)
+			std::string_view Line;
+			ReadLine(Line);
+			return std::string(Line);
+		}
+
+		//Reads the next line without the line break. Returns false at the end of the file.
+		//Line points into the read buffer of the stream and stays valid until the next call on the stream.
+		//The data is read block wise and scanned with memchr, so only lines crossing a block are copied.
+		bool ReadLine(std::string_view &Line)
+		{
+			if((m_Mode & FileMode::READ) != FileMode::READ)
+				return false;
+
+			bool Partial = false;
+			m_LineBuffer.clear();
+
+			while (FillBuffer())
 			{
-				if(c == '\n')
-					break;
+				const char *Begin = m_Buffer.data() + (m_CurPos - m_BufferPos);
+				size_t Avail = m_BufferPos + m_BufferFill - m_CurPos;
+				const char *End = (const char*)memchr(Begin, '\n', Avail);
+
+				if(End)
+				{
+					size_t Len = End - Begin;
+					m_CurPos += Len + 1;
+					if(!Partial)
+					{
+						Line = std::string_view(Begin, Len);
+						return true;
+					}
+
+					m_LineBuffer.append(Begin, Len);
+					Line = m_LineBuffer;
+					return true;
+				}
 
-				Ret += c;
+				m_LineBuffer.append(Begin, Avail);  //The line continues in the next block.
+				m_CurPos += Avail;
+				Partial = true;
 			}
 
-			return Ret;
+			Line = m_LineBuffer;
+			return Partial;
+		}
+
+		class CLineIterator
+		{
+			public:
+				using iterator_category = std::input_iterator_tag;
+				using value_type = std::string_view;
+				using difference_type = std::ptrdiff_t;
+				using pointer = const std::string_view*;
+				using reference = const std::string_view&;
+
+				CLineIterator(CVFSFileStream *Stream = nullptr) : m_Stream(Stream)
+				{
+					++*this;
+				}
+
+				reference operator*() const
+				{
+					return m_Line;
+				}
+
+				pointer operator->() const
+				{
+					return &m_Line;
+				}
+
+				CLineIterator &operator++()
+				{
+					if(m_Stream && !m_Stream->ReadLine(m_Line))
+						m_Stream = nullptr;
+
+					return *this;
+				}
+
+				bool operator==(const CLineIterator &Other) const
+				{
+					return m_Stream == Other.m_Stream;
+				}
+
+				bool operator!=(const CLineIterator &Other) const
+				{
+					return !(*this == Other);
+				}
+
+			private:
+				CVFSFileStream *m_Stream;
+				std::string_view m_Line;
+		};
+
+		struct SLineRange
+		{
+			CVFSFileStream *Stream;
+
+			CLineIterator begin() const
+			{
+				return CLineIterator(Stream);
+			}
+
+			CLineIterator end() const
+			{
+				return CLineIterator();
+			}
+		};
+
+		//Iterates over the remaining lines of the file: for (std::string_view Line : Stream->Lines()).
+		SLineRange Lines()
+		{
+			return SLineRange{this};
 		}
 
 		std::string Read()
@@ -932,12 +3790,29 @@ class CVFSFileStream
 			{
 				size_t Ret = m_File->Read(Buf, Size, m_CurPos);
 				m_CurPos += Ret;
+				if(m_UpdateAccess)
+					m_File->Touch();
 				return Ret;
 			}
 
 			return 0;
 		}
 
+		//Returns the next Size bytes without copying them, see CVFSView.
+		CVFSView ReadView(size_t Size = SIZE_MAX)
+		{
+			CVFSView Ret;
+			if((m_Mode & FileMode::READ) == FileMode::READ)
+			{
+				m_File->View(m_CurPos, Size, Ret);
+				m_CurPos += Ret.Size();
+				if(m_UpdateAccess)
+					m_File->Touch();
+			}
+
+			return Ret;
+		}
+
 		inline void Seek(Cursor cur, int64_t Bytes)
 		{
 			if(Size() == 0)
@@ -989,26 +3864,72 @@ class CVFSFileStream
 		CVFS::VFSFile m_File;
 		FileMode m_Mode;
 
+		//Makes sure that the read buffer holds the data at m_CurPos, returns false at the end of the file.
+		bool FillBuffer()
+		{
+			if(m_CurPos >= m_BufferPos && m_CurPos < m_BufferPos + m_BufferFill && m_BufferVersion == m_File->Version())
+				return true;
+
+			//Sized by what's left of the file, so small files don't get the whole block. Grows with the file.
+			size_t Want = std::min(LINE_BUFFER_SIZE, std::max<size_t>(Size() > m_CurPos ? Size() - m_CurPos : 0, 1));
+			if(m_Buffer.size() < Want)
+				m_Buffer.resize(Want);
+
+			m_BufferVersion = m_File->Version();
+			m_BufferPos = m_CurPos;
+			m_BufferFill = m_File->Read(m_Buffer.data(), m_Buffer.size(), m_CurPos);
+			if(m_UpdateAccess)
+				m_File->Touch();
+
+			return m_BufferFill != 0;
+		}
+
+		static constexpr size_t LINE_BUFFER_SIZE = 64 * 1024;
+
 		size_t m_CurPos;
+		bool m_UpdateAccess;
+
+		std::vector<char> m_Buffer;
+		std::string m_LineBuffer;   //Lines crossing the end of the buffer are assembled here.
+		size_t m_BufferPos = 0;
+		size_t m_BufferFill = 0;
+		uint64_t m_BufferVersion = 0;
 };
 
-inline VFSFileStream CVFS::Open(const std::string &Path, FileMode mode)
+inline VFSFileStream CVFS::Open(std::string_view Path, FileMode mode)
 {
-	VFSFileStream ret;
 	auto node = GetNodeInfo(Path);
 	if(node && !node->IsDir())
-		ret = VFSFileStream(new CVFSFileStream(std::static_pointer_cast<CVFSFile>(node), mode));
+	{
+		LogAccess(node, mode);
+		return VFSFileStream(new CVFSFileStream(std::static_pointer_cast<CVFSFile>(node), mode, !m_Options.NoAtime));
+	}
+
+	return OpenAt(m_Root, Path, mode);
+}
+
+inline VFSFileStream CVFS::OpenAt(VFSNode Dir, std::string_view Path, FileMode mode)
+{
+	VFSFileStream ret;
+	auto node = GetNodeInfoAt(Dir, Path);
+	if(node && !node->IsDir())
+	{
+		LogAccess(node, mode);
+		ret = VFSFileStream(new CVFSFileStream(std::static_pointer_cast<CVFSFile>(node), mode, !m_Options.NoAtime));
+	}
 	else if(node && node->IsDir())
 		throw CVFSException("Can't open file. A directory with the given name already exists.", VFSError::CANT_CREATE_FILE);
 	else if((mode & FileMode::WRITE) == FileMode::WRITE)    //Creates a new file.
 	{
-		node = GetNodeInfo(ExtractPath(Path));
-		if(node)
+		std::string_view Name;
+		node = Resolve(Dir, SplitName(Path, Name));
+		if(node && node->IsDir())
 		{
-			auto file = VFSFile(new CVFSFile(ExtractName(Path)));
+			auto file = NewFile(std::string(Name));
 			auto dir = std::static_pointer_cast<CVFSDir>(node);
 			dir->AppendChild(file);
-			ret = VFSFileStream(new CVFSFileStream(file, mode));
+			RecordNode(file, dir);
+			ret = VFSFileStream(new CVFSFileStream(file, mode, !m_Options.NoAtime));
 		}
 	}
 	else
@@ -1016,4 +3937,152 @@ inline VFSFileStream CVFS::Open(const std::string &Path, FileMode mode)
 
 	return ret;
 }
+
+//Point in time view of a CVFS, see CVFS::Snapshot(). Nodes hand their old state to the snapshot on their first change,
+//so the snapshot holds copies of the changed directories and the chunk references of the changed files only.
+//Access times are read during serialization. The filesystem has to outlive the snapshot.
+class CVFSSnapshot
+{
+	friend CVFS;
+	friend CVFSSnapshotList;
+
+	public:
+		CVFSSnapshot(const CVFSSnapshot&) = delete;
+		CVFSSnapshot &operator=(const CVFSSnapshot&) = delete;
+
+		std::vector<char> Serialize()
+		{
+			std::vector<char> Ret;
+			Serialize([&Ret](const char *Data, size_t Size) { Ret.insert(Ret.end(), Data, Data + Size); });
+			return Ret;
+		}
+
+		void Serialize(std::ostream &Out)
+		{
+			Serialize(CVFS::StreamSink(Out));
+		}
+
+		void Serialize(int Fd)
+		{
+			Serialize(CVFS::FdSink(Fd));
+		}
+
+		//Writes the image of the tree at the time of the snapshot, the image isn't part of the journal.
+		void Serialize(const CVFSWriter::Sink &Sink)
+		{
+			m_Vfs.SerializeImage(Sink, this);
+		}
+
+		//Number of nodes changed since the snapshot was taken.
+		size_t Preserved() const
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			return m_States.size();
+		}
+
+	private:
+		struct SState
+		{
+			VFSNode Node;   //Keeps the address of the node unique.
+			std::vector<std::pair<std::string, VFSNode>> Childs;
+			CVFS::CVFSFile::SContent Content;
+		};
+
+		CVFSSnapshot(CVFS &Vfs, CVFS::VFSDir Root) : m_Vfs(Vfs), m_Root(Root) {}
+
+		//The caller holds the lock of the node.
+		static std::shared_ptr<const SState> Capture(CVFSNode *Node)
+		{
+			auto Ret = std::make_shared<SState>();
+			Ret->Node = Node->shared_from_this();
+			if(Node->IsDir())
+				Ret->Childs = static_cast<CVFS::CVFSDir*>(Node)->InternalNamedChilds();
+			else
+				Ret->Content = static_cast<CVFS::CVFSFile*>(Node)->InternalContent();
+
+			return Ret;
+		}
+
+		//Keeps the first state only, later changes aren't part of the snapshot.
+		void Keep(const CVFSNode *Node, const std::shared_ptr<const SState> &State)
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			m_States.emplace(Node, State);
+		}
+
+		//Returns the state of the node at the time of the snapshot or nullptr, if the node is unchanged.
+		//The caller holds the lock of the node.
+		const SState *Find(const CVFSNode *Node) const
+		{
+			std::lock_guard<std::mutex> lock(m_Lock);
+			auto It = m_States.find(Node);
+			return It != m_States.end() ? It->second.get() : nullptr;
+		}
+
+		CVFS &m_Vfs;
+		CVFS::VFSDir m_Root;
+		uint64_t m_Epoch = 0;
+
+		std::unordered_map<const CVFSNode*, std::shared_ptr<const SState>> m_States;
+		mutable std::mutex m_Lock;
+};
+
+inline void CVFSSnapshotList::Add(const std::shared_ptr<CVFSSnapshot> &Snapshot)
+{
+	std::lock_guard<std::mutex> lock(m_Lock);
+	std::erase_if(m_Snapshots, [](const std::weak_ptr<CVFSSnapshot> &e) { return e.expired(); });
+
+	Snapshot->m_Epoch = m_Epoch.load(std::memory_order_relaxed) + 1;
+	m_Snapshots.push_back(Snapshot);
+	m_Epoch.store(Snapshot->m_Epoch, std::memory_order_release);
+}
+
+inline void CVFSSnapshotList::Preserve(CVFSNode *Node, uint64_t Changed)
+{
+	std::shared_ptr<const CVFSSnapshot::SState> State;
+	std::lock_guard<std::mutex> lock(m_Lock);
+	for (auto &&e : m_Snapshots)
+	{
+		auto Snapshot = e.lock();
+		if(Snapshot && Snapshot->m_Epoch > Changed)
+		{
+			if(!State)
+				State = CVFSSnapshot::Capture(Node);
+
+			Snapshot->Keep(Node, State);
+		}
+	}
+}
+
+//Only changes of several nodes (create, move, copy) are blocked for the moment, single node changes check the epoch.
+inline std::shared_ptr<CVFSSnapshot> CVFS::Snapshot()
+{
+	std::lock_guard<std::shared_mutex> lock(m_TreeLock);
+	auto Ret = std::shared_ptr<CVFSSnapshot>(new CVFSSnapshot(*this, m_Root));
+	m_Snapshots->Add(Ret);
+	return Ret;
+}
+
+inline CVFS::VFSDir CVFS::Root(const CVFSSnapshot *Snapshot) const
+{
+	return Snapshot ? Snapshot->m_Root : m_Root;
+}
+
+inline std::vector<std::pair<std::string, VFSNode>> CVFS::NamedChilds(CVFSDir &Dir, const CVFSSnapshot *Snapshot)
+{
+	std::shared_lock<std::shared_mutex> lock(Dir.m_UpdateLock);
+	if(auto State = Snapshot ? Snapshot->Find(&Dir) : nullptr)
+		return State->Childs;
+
+	return Dir.InternalNamedChilds();
+}
+
+inline CVFS::CVFSFile::SContent CVFS::Content(CVFSFile &File, const CVFSSnapshot *Snapshot)
+{
+	std::shared_lock<std::shared_mutex> lock(File.m_UpdateLock);
+	if(auto State = Snapshot ? Snapshot->Find(&File) : nullptr)
+		return State->Content;
+
+	return File.InternalContent();
+}
 } // namespace Assets
\ No newline at end of file
@@ -0,0 +1,193 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <ctime>
+#include <climits>
+#include <string.h>
+
+#include <stb_image.h>
+
+#include "MappedImage.hh"
+
+namespace Assets {
+
+struct SZipEntry
+{
+	std::string Name;	//Path inside the archive, directories end with '/'.
+	uint64_t HeaderOffset;
+	uint32_t CompressedSize;
+	uint32_t Size;
+	uint16_t Method;
+	uint16_t Flags;
+	time_t Modified;
+};
+
+//Read only zip archive. The archive is mapped and the central directory is indexed once,
+//entries are only touched when they are extracted. Supports stored and deflated entries, no zip64.
+class CZipArchive
+{
+	public:
+		static constexpr uint16_t STORED = 0;
+		static constexpr uint16_t DEFLATED = 8;
+		static constexpr uint16_t ENCRYPTED = 1;
+
+		CZipArchive(const std::string &Path) : m_Image(Path)
+		{
+			if(m_Image.IsOpen())
+				m_Valid = ReadCentralDirectory();
+		}
+
+		CZipArchive(const CZipArchive&) = delete;
+		CZipArchive &operator=(const CZipArchive&) = delete;
+
+		inline bool IsOpen() const
+		{
+			return m_Valid;
+		}
+
+		inline const std::vector<SZipEntry> &Entries() const
+		{
+			return m_Entries;
+		}
+
+		//Returns the stored data of the entry inside the mapping or nullptr, if the local header is broken.
+		const char *Data(const SZipEntry &Entry) const
+		{
+			const char *Base = m_Image.Data();
+			size_t Size = m_Image.Size();
+			if(Entry.HeaderOffset > Size || Size - Entry.HeaderOffset < LOCAL_HEADER_SIZE || Read32(Base + Entry.HeaderOffset) != LOCAL_HEADER_SIGNATURE)
+				return nullptr;
+
+			uint64_t Offset = Entry.HeaderOffset + LOCAL_HEADER_SIZE + Read16(Base + Entry.HeaderOffset + 26) + Read16(Base + Entry.HeaderOffset + 28);
+			if(Offset > Size || Size - Offset < Entry.CompressedSize)
+				return nullptr;
+
+			return Base + Offset;
+		}
+
+		//Extracts the entry into Dst, which has to hold Entry.Size bytes.
+		bool Extract(const SZipEntry &Entry, char *Dst) const
+		{
+			const char *Src = Data(Entry);
+			if(!Src || (Entry.Flags & ENCRYPTED))
+				return false;
+
+			if(Entry.Method == STORED)
+			{
+				if(Entry.CompressedSize != Entry.Size)
+					return false;
+
+				memcpy(Dst, Src, Entry.Size);
+				return true;
+			}
+
+			if(Entry.Method != DEFLATED || Entry.Size > INT_MAX || Entry.CompressedSize > INT_MAX - INFLATE_SLACK)
+				return false;
+
+			//The inflater reads a few bytes past the end of raw deflate streams (zlib streams end with a checksum),
+			//these bytes aren't used. They are part of the mapping, except for a broken archive.
+			std::vector<char> Padded;
+			if((size_t)(m_Image.Data() + m_Image.Size() - Src) < Entry.CompressedSize + INFLATE_SLACK)
+			{
+				Padded.assign(Src, Src + Entry.CompressedSize);
+				Padded.resize(Padded.size() + INFLATE_SLACK);
+				Src = Padded.data();
+			}
+
+			return stbi_zlib_decode_noheader_buffer(Dst, (int)Entry.Size, Src, (int)(Entry.CompressedSize + INFLATE_SLACK)) == (int)Entry.Size;
+		}
+
+	private:
+		static constexpr uint32_t END_SIGNATURE = 0x06054b50;
+		static constexpr uint32_t CENTRAL_SIGNATURE = 0x02014b50;
+		static constexpr uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+		static constexpr size_t END_SIZE = 22;
+		static constexpr size_t CENTRAL_SIZE = 46;
+		static constexpr size_t LOCAL_HEADER_SIZE = 30;
+		static constexpr uint32_t INFLATE_SLACK = 4;
+
+		static uint16_t Read16(const char *Src)
+		{
+			return (uint8_t)Src[0] | ((uint8_t)Src[1] << 8);
+		}
+
+		static uint32_t Read32(const char *Src)
+		{
+			return Read16(Src) | ((uint32_t)Read16(Src + 2) << 16);
+		}
+
+		static time_t DosTime(uint16_t Time, uint16_t Date)
+		{
+			std::tm Tm{};
+			Tm.tm_sec = (Time & 0x1F) * 2;
+			Tm.tm_min = (Time >> 5) & 0x3F;
+			Tm.tm_hour = Time >> 11;
+			Tm.tm_mday = Date & 0x1F;
+			Tm.tm_mon = ((Date >> 5) & 0x0F) - 1;
+			Tm.tm_year = (Date >> 9) + 80;
+			Tm.tm_isdst = -1;
+			return std::mktime(&Tm);
+		}
+
+		bool ReadCentralDirectory()
+		{
+			const char *Base = m_Image.Data();
+			size_t Size = m_Image.Size();
+			if(Size < END_SIZE)
+				return false;
+
+			//The end record is followed by a comment of up to 64 KiB.
+			size_t End = Size - END_SIZE;
+			size_t Stop = End > 0xFFFF ? End - 0xFFFF : 0;
+			while (Read32(Base + End) != END_SIGNATURE)
+			{
+				if(End == Stop)
+					return false;
+
+				End--;
+			}
+
+			size_t Count = Read16(Base + End + 10);
+			uint64_t Pos = Read32(Base + End + 16);
+			uint64_t DirSize = Read32(Base + End + 12);
+			if(Pos > End || DirSize > End - Pos)
+				return false;
+
+			m_Entries.reserve(Count);
+			uint64_t DirEnd = Pos + DirSize;
+			for (size_t i = 0; i < Count; i++)
+			{
+				if(DirEnd - Pos < CENTRAL_SIZE || Read32(Base + Pos) != CENTRAL_SIGNATURE)
+					return false;
+
+				const char *Header = Base + Pos;
+				size_t NameSize = Read16(Header + 28);
+				size_t Skip = CENTRAL_SIZE + NameSize + Read16(Header + 30) + Read16(Header + 32);
+				if(DirEnd - Pos < Skip)
+					return false;
+
+				SZipEntry Entry;
+				Entry.Flags = Read16(Header + 8);
+				Entry.Method = Read16(Header + 10);
+				Entry.Modified = DosTime(Read16(Header + 12), Read16(Header + 14));
+				Entry.CompressedSize = Read32(Header + 20);
+				Entry.Size = Read32(Header + 24);
+				Entry.HeaderOffset = Read32(Header + 42);
+				Entry.Name.assign(Header + CENTRAL_SIZE, NameSize);
+				m_Entries.push_back(std::move(Entry));
+
+				Pos += Skip;
+			}
+
+			return true;
+		}
+
+		CMappedImage m_Image;
+		std::vector<SZipEntry> m_Entries;
+		bool m_Valid = false;
+};
+
+} // namespace Assets
@@ -1,39 +1,79 @@
 #include "Audio.hh"
 
+#include <chrono>
+#include <cmath>
+#include <thread>
+
 namespace Audio
 {
+	namespace
+	{
+		// Voice stealing compares the louder channel.
+		float Loudness(const Mixer::Gains& gains)
+		{
+			return std::max(std::fabs(gains.left), std::fabs(gains.right));
+		}
+	}
+
 	Audio::Audio()
 		:decoder{}
 	{}
 
 	void Audio::Wait() const
 	{
-		if(!silence)
+		while (IsPlaying() && stream)
 		{
-			std::unique_lock<std::mutex> lock {mutex};
-			cvDone.wait(lock, [this] { return silence; });
+			stream->Update();
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
 		}
 	}
 
 	bool Audio::IsPlaying() const
 	{
-		return !silence;
+		return plays.load(std::memory_order_acquire) != 0;
 	}
 
 	void Audio::Stop()
 	{
-		stoplater = true;
+		if(stream)
+			stream->Send({SndOutStream::Command::Type::Stop, this});
 	}
 
-	void Audio::SetEndCallback(std::function<void()> callback)
+	void Audio::SetVol(float val)
 	{
-		onFinishCallback = std::move(callback);
+		vol = val;
+		if(stream)
+			stream->Send({SndOutStream::Command::Type::SetVol, this, val});
+	}
+
+	void Audio::SetPan(float val)
+	{
+		pan = val;
+		if(stream)
+			stream->Send({SndOutStream::Command::Type::SetPan, this, val});
+	}
+
+	void Audio::SetPitch(float val)
+	{
+		pitch = val;
+		if(stream)
+			stream->Send({SndOutStream::Command::Type::SetPitch, this, val});
 	}
 
-	void Audio::Rewind()
+	void Audio::Seek(unsigned long long frame)
 	{
-		stoplater = false;
-		ma_decoder_seek_to_pcm_frame(&decoder, 0);
+		if(stream)
+			stream->Send({SndOutStream::Command::Type::Seek, this, 0.0f, frame});
+	}
+
+	unsigned Audio::SampleRate() const
+	{
+		return decoder.outputSampleRate;
+	}
+
+	void Audio::SetEndCallback(std::function<void()> callback)
+	{
+		onFinishCallback = std::move(callback);
 	}
 
 	unsigned Audio::Data(void* output, unsigned frameCount)
@@ -41,51 +81,61 @@ namespace Audio
 		const auto framesDecoded =
 			ma_decoder_read_pcm_frames(&decoder, output, frameCount);
 
-		bool silenceNow = framesDecoded == 0 || stoplater;
-		if (silenceNow && !silence)
-		{
-			{
-				std::lock_guard<std::mutex> lock{mutex};
-				silence = true;
-			}
-			EndedPlayingCallback();
-		}
-		else
-		{
-			silenceNow = silenceNow;
-		}
-
 		return unsigned(framesDecoded);
 	}
 
-	void Audio::EndedPlayingCallback()
+	void Audio::SeekFrame(unsigned long long frame)
 	{
-		if(onFinishCallback)
-			onFinishCallback();
-		cvDone.notify_all();
+		ma_decoder_seek_to_pcm_frame(&decoder, frame);
 	}
 
 	AudioFile::AudioFile(std::string filename)
 	{
-		ma_decoder_config cfg = ma_decoder_config_init(ma_format_f32, 2, 44100); // TODO read from device
+		ma_decoder_config cfg = ma_decoder_config_init(ma_format_f32, 2, 0);
 		ma_decoder_init_file(filename.c_str(), &cfg, &decoder);
 	}
 
 	AudioMemView::AudioMemView(const void* data, std::size_t size)
 	{
-		ma_decoder_config cfg = ma_decoder_config_init(ma_format_f32, 2, 44100); // TODO read from device
+		ma_decoder_config cfg = ma_decoder_config_init(ma_format_f32, 2, 0);
 		ma_decoder_init_memory(data, size, &cfg, &decoder);
 	}
 
+	AudioMemView::AudioMemView(const void* data, std::size_t size, std::shared_ptr<const void> owner)
+		: AudioMemView(data, size)
+	{
+		this->owner = std::move(owner);
+	}
+
 	SndOutStream::SndOutStream(const SndOutStreamConfig& config)
-		: dev{}, devcfg(MakeMAConfig(config))
+		: dev{}, devcfg(MakeMAConfig(config)), commands(config.commandQueueSize),
+		  finished(config.commandQueueSize + config.maxVoices + 1),
+		  limit(config.limiterThreshold)
 	{
-		ma_device_init(nullptr, &devcfg, &dev);
+		// The audio thread must not allocate, so its buffers are sized here, for at least one device period.
+		voices.reserve(config.maxVoices);
+		Resampler::Init();
+		initialized = ma_device_init(nullptr, &devcfg, &dev) == MA_SUCCESS;
+
+		// Without a device the stream still takes commands, 48 kHz is the common native rate.
+		rate = initialized ? dev.sampleRate : (config.sampleRate ? config.sampleRate : 48000);
+		std::size_t frames = std::size_t(rate) * config.bufSizeMS / 1000;
+		if(initialized)
+			frames = std::max<std::size_t>(frames, dev.playback.internalPeriodSizeInFrames);
+		// Decoders always deliver stereo.
+		framesBuf.resize(std::max<std::size_t>(frames, 1) * std::max<unsigned>(config.channels, 2));
+		resampleBuf.resize(Resampler::scratchSamples);
 	}
 
 	SndOutStream::~SndOutStream()
 	{
-		ma_device_uninit(&dev);
+		if(initialized)
+			ma_device_uninit(&dev);
+		initialized = false;
+
+		// Every voice is reported as finished, so no Audio keeps a pointer to the stream.
+		Send({Command::Type::StopAll});
+		Collect();
 	}
 
 	void SndOutStream::Start()
@@ -95,35 +145,238 @@ namespace Audio
 
 	void SndOutStream::StopAll()
 	{
-		stoplater = true;
+		Send({Command::Type::StopAll});
 	}
 
 	void SndOutStream::StopStream()
 	{
 		StopAll();
-		ma_device_stop(&dev);
+		if(initialized)
+		{
+			ma_device_stop(&dev);
+			stopped = true;
+		}
+
+		ProcessCommands();
 	}
 
 	void SndOutStream::Play(Audio& audio)
 	{
-		audio.Rewind();
-		audio.silence = false;
-		audios.push_back(&audio);
+		Collect();
+		audio.stream = this;
+		audio.plays.fetch_add(1, std::memory_order_acq_rel);
+		++active;
+		Send({Command::Type::Play, &audio, audio.vol, 0, audio.pan, nullptr, audio.pitch});
+		PlayImpl();
+	}
+
+	void SndOutStream::Play(std::shared_ptr<const SoundClip> clip, float vol, float pan, float pitch)
+	{
+		// Only stereo is resampled, other layouts must match the device rate.
+		if(!clip || clip->Channels() != Channels() || (Channels() != 2 && (clip->SampleRate() != SampleRate() || pitch != 1.0f)))
+			return;
+
+		Collect();
+		const SoundClip* raw = clip.get();
+		++clips.try_emplace(raw, ClipRef{std::move(clip), 0}).first->second.plays;
+		++active;
+
+		Command command {Command::Type::Play, nullptr, vol, 0, pan, raw, pitch};
+		Send(command);
 		PlayImpl();
 	}
 
-	void SndOutStream::Wait() const
+	void SndOutStream::Stop(const SoundClip& clip)
 	{
-		if(!silence)
+		Command command {Command::Type::StopClip};
+		command.clip = &clip;
+		Send(command);
+	}
+
+	void SndOutStream::Wait()
+	{
+		for (Update(); active != 0; Update())
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	void SndOutStream::SetVol(float val)
+	{
+		Send({Command::Type::SetStreamVol, nullptr, val});
+	}
+
+	void SndOutStream::Update()
+	{
+		Collect();
+
+		// Callbacks may start new sounds, which end up in a new list.
+		auto done = std::move(ended);
+		ended.clear();
+		for (auto* audio : done)
 		{
-			std::unique_lock<std::mutex> lock {mutex};
-			cvDone.wait(lock, [this] { return silence; });
+			if(audio->onFinishCallback)
+				audio->onFinishCallback();
 		}
 	}
 
-	void SndOutStream::SetVol(float val)
+	unsigned SndOutStream::SampleRate() const
 	{
-		vol = val;
+		return rate;
+	}
+
+	unsigned SndOutStream::Channels() const
+	{
+		return devcfg.playback.channels;
+	}
+
+	// The callback may still run while the device is starting or stopping, so only a device, which was never started
+	// or whose stop returned, counts as stopped. One that stopped by itself (e.g. unplugged) is STOPPED after its last callback.
+	bool SndOutStream::Running()
+	{
+		if(initialized && !stopped && ma_device_get_state(&dev) == MA_STATE_STOPPED)
+			stopped = true;
+
+		return initialized && !stopped;
+	}
+
+	void SndOutStream::Send(const Command& command)
+	{
+		// A full queue waits for the next period. A stopped device doesn't drain the queue,
+		// then the game thread is the only one touching the voices and applies the commands itself.
+		while (!commands.Push(command))
+		{
+			Collect();
+			if(!Running())
+				ProcessCommands();
+			else
+				std::this_thread::yield();
+		}
+
+		if(!Running())
+			ProcessCommands();
+	}
+
+	void SndOutStream::Collect()
+	{
+		Ended voice;
+		while (finished.Pop(voice))
+		{
+			--active;
+			if(voice.clip)
+			{
+				// The last instance lets go of the clip, which may free it here on the game thread.
+				auto it = clips.find(voice.clip);
+				if(--it->second.plays == 0)
+					clips.erase(it);
+			}
+			else if(voice.audio->plays.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				voice.audio->stream = nullptr;
+				ended.push_back(voice.audio);
+			}
+		}
+	}
+
+	void SndOutStream::ProcessCommands()
+	{
+		auto find = [this](const Audio* audio)
+		{
+			return std::find_if(voices.begin(), voices.end(), [audio](const Voice& v) { return v.audio == audio; }) - voices.begin();
+		};
+
+		Command command;
+		while (commands.Pop(command))
+		{
+			std::size_t voice = command.audio ? std::size_t(find(command.audio)) : voices.size();
+			switch (command.type)
+			{
+			case Command::Type::Play:
+			{
+				if(voice != voices.size())	// Restarts the voice, the earlier play ends.
+					Finish(voice);
+
+				Voice started {command.audio, command.value, command.pan, Mixer::Pan(command.value, command.pan), command.clip};
+				started.rate = started.clip ? started.clip->SampleRate() : started.audio->SampleRate();
+				if(started.rate == 0)	// The decoder failed to open, there is nothing to play.
+				{
+					finished.Push({started.audio, started.clip});
+					break;
+				}
+
+				SetPitch(started, command.pitch);
+				if(voices.size() == voices.capacity())
+				{
+					const auto quietest = std::min_element(voices.begin(), voices.end(), [](const Voice& a, const Voice& b)
+					{
+						return Loudness(a.gains) < Loudness(b.gains);
+					});
+
+					if(voices.empty() || Loudness(started.gains) <= Loudness(quietest->gains))
+					{
+						finished.Push({started.audio, started.clip});
+						break;
+					}
+					Finish(std::size_t(quietest - voices.begin()));
+				}
+
+				if(started.audio)
+					started.audio->SeekFrame(0);
+				voices.push_back(started);
+				break;
+			}
+			case Command::Type::Stop:
+				if(voice != voices.size())
+					Finish(voice);
+				break;
+			case Command::Type::StopClip:
+				for (std::size_t i = voices.size(); i-- > 0;)
+				{
+					if(voices[i].clip == command.clip)
+						Finish(i);
+				}
+				break;
+			case Command::Type::StopAll:
+				while (!voices.empty())
+					Finish(voices.size() - 1);
+				break;
+			case Command::Type::SetVol:
+				if(voice != voices.size())
+				{
+					voices[voice].vol = command.value;
+					voices[voice].gains = Mixer::Pan(voices[voice].vol, voices[voice].pan);
+				}
+				break;
+			case Command::Type::SetPan:
+				if(voice != voices.size())
+				{
+					voices[voice].pan = command.value;
+					voices[voice].gains = Mixer::Pan(voices[voice].vol, voices[voice].pan);
+				}
+				break;
+			case Command::Type::SetPitch:
+				if(voice != voices.size())
+					SetPitch(voices[voice], command.value);
+				break;
+			case Command::Type::SetStreamVol:
+				vol = command.value;
+				break;
+			case Command::Type::Seek:
+				if(voice != voices.size())
+				{
+					command.audio->SeekFrame(command.frame);
+					voices[voice].resampler = {};
+				}
+				break;
+			}
+		}
+	}
+
+	// The finished queue holds every play, which can be outstanding between two calls of Collect(),
+	// because Play() collects before sending. So the push never fails.
+	void SndOutStream::Finish(std::size_t voice)
+	{
+		finished.Push({voices[voice].audio, voices[voice].clip});
+		voices[voice] = voices.back();
+		voices.pop_back();
 	}
 
 	void SndOutStream::DataCallback(ma_device* dev, void* output, const void* input, ma_uint32 frameCount)
@@ -135,45 +388,62 @@ namespace Audio
 
 	void SndOutStream::DataCallbackImpl(void* output, ma_uint32 frameCount)
 	{
-		std::size_t buffer_size_frames =
-			frameCount * devcfg.playback.channels;
+		ProcessCommands();
 
-		framesBuf.resize(buffer_size_frames);
-		float32* audio_output = framesBuf.data();
+		const unsigned channels = devcfg.playback.channels;
 		auto fOutput = static_cast<float32*>(output);
-		std::memset(fOutput, 0, buffer_size_frames * sizeof(float32));
+		std::memset(fOutput, 0, std::size_t(frameCount) * channels * sizeof(float32));
 
-		for (auto* audio : audios)
-		{
-			const auto framesDecoded = audio->Data(audio_output, frameCount);
-			for (unsigned i = 0;
-				 i < framesDecoded * devcfg.playback.channels; ++i)
-				fOutput[i] += vol * audio_output[i];
-		}
-
-		// Remove all finished audios:
-		auto toRemove = stoplater
-							? audios.begin()
-							: std::remove_if(audios.begin(), audios.end(),
-											 [](const Audio* a) {
-												 return !a->IsPlaying();
-											 });
-		audios.erase(toRemove, audios.end());
-		if (audios.empty() && !silence)
+		// Periods longer than the preallocated buffer are mixed in parts.
+		const unsigned bufFrames = unsigned(framesBuf.size() / std::max(channels, 2u));
+		for (unsigned offset = 0; offset < frameCount; offset += bufFrames)
 		{
+			const unsigned count = std::min(bufFrames, frameCount - offset);
+			for (std::size_t i = 0; i < voices.size();)
 			{
-				std::lock_guard<std::mutex> lock{mutex};
-				silence = true;
+				Voice& v = voices[i];
+				unsigned framesDecoded;
+				const float32* src;
+				if(v.resample)
+				{
+					framesDecoded = Resampler::Process(v.resampler, framesBuf.data(), count, Step(v), resampleBuf.data(),
+						[&v](float32* input, std::size_t frames) { return Read(v, input, frames); });
+					src = framesBuf.data();
+				}
+				else
+				{
+					if(v.clip)	// Mixed straight from the shared samples.
+					{
+						framesDecoded = unsigned(std::min<std::size_t>(count, v.clip->Frames() - v.cursor));
+						src = v.clip->Samples() + v.cursor * channels;
+						v.cursor += framesDecoded;
+					}
+					else
+					{
+						framesDecoded = v.audio->Data(framesBuf.data(), count);
+						src = framesBuf.data();
+					}
+
+					if(v.audio || channels == 2)
+						Resampler::Feed(v.resampler, src, framesDecoded);
+				}
+
+				// Decoders and the resampler deliver stereo, which is mapped onto the device's layout, mono can't pan.
+				// Clips of other layouts match the device and get the plain volume on every channel.
+				float32* dst = fOutput + std::size_t(offset) * channels;
+				if(v.audio || v.resample)
+					Mixer::AccumulateStereo(dst, channels, src, framesDecoded, channels == 1 ? Mixer::Gains{v.vol, v.vol} : v.gains);
+				else
+					Mixer::Accumulate(dst, src, std::size_t(framesDecoded) * channels, channels == 2 ? v.gains : Mixer::Gains{v.vol, v.vol});
+
+				if(framesDecoded < count)
+					Finish(i);
+				else
+					++i;
 			}
-			EndedPlayingCallback();
 		}
-		silence = audios.empty();
-	}
 
-	void SndOutStream::EndedPlayingCallback()
-	{
-		stoplater = false;
-		cvDone.notify_all();
+		Mixer::MasterLimit(fOutput, std::size_t(frameCount) * channels, vol, limit);
 	}
 
 	ma_device_config SndOutStream::MakeMAConfig(const SndOutStreamConfig& osCfg)
@@ -188,12 +458,39 @@ namespace Audio
 		return cfg;
 	}
 
+	double SndOutStream::Step(const Voice& voice) const
+	{
+		return double(voice.rate) / rate * voice.pitch;
+	}
+
+	// Decoders deliver stereo on every device, so they can always be resampled. Clips have the layout of the device,
+	// only stereo ones can be resampled, the others were converted to the device rate by SoundBank.
+	void SndOutStream::SetPitch(Voice& voice, float pitch)
+	{
+		voice.pitch = pitch;
+		voice.resample = (voice.audio || Channels() == 2) && (voice.resample || Step(voice) != 1.0);
+	}
+
+	std::size_t SndOutStream::Read(Voice& voice, float32* output, std::size_t frames)
+	{
+		if(!voice.clip)
+			return voice.audio->Data(output, unsigned(frames));
+
+		frames = std::min(frames, voice.clip->Frames() - voice.cursor);
+		std::copy_n(voice.clip->Samples() + voice.cursor * 2, frames * 2, output);
+		voice.cursor += frames;
+		return frames;
+	}
+
 	void SndOutStream::PlayImpl()
 	{
-		silence = false;
-		if(ma_device_get_state(&dev) != MA_STATE_STOPPED)
+		if(!initialized || Running())
 			return;
-		ma_device_start(&dev);
+
+		// Cleared before, the callback may run before ma_device_start returns.
+		stopped = false;
+		if(ma_device_start(&dev) != MA_SUCCESS)
+			stopped = true;
 	}
 
 	SndOutStream& operator<<(SndOutStream& aout, Audio& a)
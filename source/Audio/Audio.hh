@@ -1,39 +1,62 @@
 #pragma once
 #include <algorithm>
-#include <condition_variable>
+#include <atomic>
 #include <string>
 #include <cstring>
 #include <exception>
 #include <functional>
-#include <mutex>
+#include <memory>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include <miniaudio.h>
 
+#include "Misc/Threads/SpscQueue.hh"
+#include "Mixer.hh"
+#include "Resampler.hh"
+#include "SoundBank.hh"
+
 
 namespace Audio
 {
+	class SndOutStream;
+
+	// Control calls (Stop, SetVol, SetPan, SetPitch, Seek, SndOutStream::Play) are made from one thread, the game thread.
+	// They are queued to the audio thread, which owns the playing voices and the decoder.
+	// Sources decode at their own rate, the stream resamples them to the device rate.
 	class Audio
 	{
 		friend class SndOutStream;
 
 	public:
+		virtual ~Audio() = default;
+
 		void Wait() const;
 		bool IsPlaying() const;
 		void Stop();
+		void SetVol(float val);
+		// -1 is left, 0 centre, 1 right (equal-power).
+		void SetPan(float val);
+		// Playback speed, 2 is an octave up. It's part of the resampling step, so it costs nothing extra.
+		void SetPitch(float val);
+		void Seek(unsigned long long frame);
+		// Rate of the decoded source.
+		unsigned SampleRate() const;
+		// The callback runs on the game thread inside SndOutStream::Update().
 		void SetEndCallback(std::function<void()> callback);
 
 	private:
-		void Rewind();
-		unsigned Data(void* output, unsigned frame_count);
-		void EndedPlayingCallback();
+		// Audio thread. Returns fewer frames than asked for only at the end.
+		virtual unsigned Data(void* output, unsigned frameCount);
+		virtual void SeekFrame(unsigned long long frame);
 
-		mutable std::mutex mutex {};
-		mutable std::condition_variable cvDone {};
 		std::function<void()> onFinishCallback {};
-		bool silence {true};
-		bool stoplater {false};
+		SndOutStream* stream {nullptr};	// Set while playing.
+		std::atomic<unsigned> plays {0};	// Plays, which weren't reported as finished yet.
+		float vol {1.0f};
+		float pan {0.0f};
+		float pitch {1.0f};
 
 	protected:
 		Audio();
@@ -52,19 +75,29 @@ namespace Audio
 	{
 	public:
 		AudioMemView(const void* data, std::size_t size);
+		// The decoder reads the memory while playing, owner keeps it alive (e.g. CVFSView::Pin()).
+		AudioMemView(const void* data, std::size_t size, std::shared_ptr<const void> owner);
+
+	private:
+		std::shared_ptr<const void> owner;
 	};
 
 
 	struct SndOutStreamConfig
 	{
-		unsigned int sampleRate{44100};
+		unsigned int sampleRate{0};	// 0 opens the device at its own rate, so miniaudio doesn't resample the mix again.
 		unsigned int bufSizeMS{200};
 		unsigned short channels{2};
+		unsigned short maxVoices{64};	// Beyond this a play replaces the quietest voice, or ends at once if it's quieter itself.
+		unsigned int commandQueueSize{256};
+		float limiterThreshold{0.8f};	// Master bus level, where the soft limiter starts bending. 1 turns it off.
 	};
 
 
 	class SndOutStream final
 	{
+		friend class Audio;
+
 		using float32 = float;
 		static_assert(sizeof(float32) == 4, "Platform is not supported");
 
@@ -82,25 +115,97 @@ namespace Audio
 		void StopAll();
 		void StopStream();
 		void Play(Audio& audio);
-		void Wait() const;
+		// Starts one more instance of the clip. The clip must have the channels of the stream (see SoundBank), others are ignored.
+		void Play(std::shared_ptr<const SoundClip> clip, float vol = 1.0f, float pan = 0.0f, float pitch = 1.0f);
+		// Stops every instance of the clip.
+		void Stop(const SoundClip& clip);
+		void Wait();
 		void SetVol(float val);
+		// Takes the finished notifications of the audio thread and runs the end callbacks. Call it once per frame.
+		void Update();
+
+		// The rate the device runs at, once it's open.
+		unsigned SampleRate() const;
+		unsigned Channels() const;
 
 	private:
+		struct Command
+		{
+			enum class Type : unsigned char { Play, Stop, StopClip, StopAll, SetVol, SetPan, SetPitch, SetStreamVol, Seek };
+
+			Type type {Type::Play};
+			Audio* audio {nullptr};
+			float value {0.0f};
+			unsigned long long frame {0};
+			float pan {0.0f};	// Play only, value holds the volume.
+			const SoundClip* clip {nullptr};	// Set instead of audio for clips.
+			float pitch {1.0f};	// Play only
+		};
+
+		// Plays either an Audio, which decodes while mixing, or a clip from its cursor.
+		struct Voice
+		{
+			Audio* audio;
+			float vol;
+			float pan;
+			Mixer::Gains gains;	// vol and pan as per channel gains.
+			const SoundClip* clip {nullptr};
+			std::size_t cursor {0};	// Frame of the clip.
+			float pitch {1.0f};
+			unsigned rate {0};	// Of the source
+			bool resample {false};	// Once resampling, a voice stays so, switching back would skip frames.
+			Resampler::State resampler {};
+		};
+
+		struct Ended
+		{
+			Audio* audio;
+			const SoundClip* clip;
+		};
+
+		struct ClipRef
+		{
+			std::shared_ptr<const SoundClip> clip;
+			unsigned plays;
+		};
+
 		static void DataCallback(ma_device* dev, void* output, const void* input, ma_uint32 frameCount);
 		void DataCallbackImpl(void* output, ma_uint32 frameCount);
-		void EndedPlayingCallback();
 		ma_device_config MakeMAConfig(const SndOutStreamConfig& sndoutstrcfg);
+		double Step(const Voice& voice) const;
+		void SetPitch(Voice& voice, float pitch);
+		static std::size_t Read(Voice& voice, float32* output, std::size_t frames);
 		void PlayImpl();
+		bool Running();
+
+		// Game thread
+		void Send(const Command& command);
+		void Collect();
+
+		// Audio thread, or the game thread while the device is stopped
+		void ProcessCommands();
+		void Finish(std::size_t voice);
 
 		ma_device dev;
 		ma_device_config devcfg;
-		mutable std::mutex mutex;
-		mutable std::condition_variable cvDone;
-		std::vector<Audio*> audios;
+		bool initialized {false};
+		bool stopped {true};	// Game thread. Set after ma_device_stop returned, cleared before ma_device_start.
+
+		Threads::SpscQueue<Command> commands;
+		Threads::SpscQueue<Ended> finished;
+		unsigned rate;
+
+		// Audio thread state
+		std::vector<Voice> voices;
 		std::vector<float32> framesBuf;
+		std::vector<float32> resampleBuf;
 		float vol {1.0f};
-		bool stoplater {false};
-		bool silence {true};
+		float limit;
+
+		// Game thread state
+		std::vector<Audio*> ended;
+		std::unordered_map<const SoundClip*, ClipRef> clips;	// Keeps playing clips alive.
+		unsigned active {0};
 	};
 
 	SndOutStream& operator<<(SndOutStream& aout, Audio& a);
@@ -0,0 +1,154 @@
+#include "Mixer.hh"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__) || defined(__AVX512F__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+namespace Audio::Mixer
+{
+	namespace
+	{
+		// Soft knee: y = t + (1 - t) * e / (1 + e), where e is the overshoot above t scaled by 1 / (1 - t).
+		// The slope is 1 at the knee and y approaches 1 for loud samples.
+		inline float Limit(float x, float threshold, float invRange)
+		{
+			const float a = std::fabs(x);
+			const float e = std::max(a - threshold, 0.0f) * invRange;
+			return std::copysign(std::min(a, threshold) + (1.0f - threshold) * e / (1.0f + e), x);
+		}
+	}
+
+	Gains Pan(float vol, float pan)
+	{
+		const float angle = (std::clamp(pan, -1.0f, 1.0f) + 1.0f) * 0.25f * 3.14159265f;
+		const float scale = vol * 1.41421356f;
+		return {scale * std::cos(angle), scale * std::sin(angle)};
+	}
+
+	void Accumulate(float* dst, const float* src, std::size_t samples, Gains gains)
+	{
+		std::size_t i = 0;
+
+#if defined(__AVX512F__)
+		const __m512 g = _mm512_setr_ps(gains.left, gains.right, gains.left, gains.right,
+		                                gains.left, gains.right, gains.left, gains.right,
+		                                gains.left, gains.right, gains.left, gains.right,
+		                                gains.left, gains.right, gains.left, gains.right);
+		for (; i + 16 <= samples; i += 16)
+			_mm512_storeu_ps(dst + i, _mm512_fmadd_ps(_mm512_loadu_ps(src + i), g, _mm512_loadu_ps(dst + i)));
+#elif defined(__AVX__)
+		const __m256 g = _mm256_setr_ps(gains.left, gains.right, gains.left, gains.right,
+		                                gains.left, gains.right, gains.left, gains.right);
+		for (; i + 16 <= samples; i += 16)
+		{
+			const __m256 s0 = _mm256_loadu_ps(src + i);
+			const __m256 s1 = _mm256_loadu_ps(src + i + 8);
+#if defined(__FMA__)
+			_mm256_storeu_ps(dst + i, _mm256_fmadd_ps(s0, g, _mm256_loadu_ps(dst + i)));
+			_mm256_storeu_ps(dst + i + 8, _mm256_fmadd_ps(s1, g, _mm256_loadu_ps(dst + i + 8)));
+#else
+			_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(s0, g)));
+			_mm256_storeu_ps(dst + i + 8, _mm256_add_ps(_mm256_loadu_ps(dst + i + 8), _mm256_mul_ps(s1, g)));
+#endif
+		}
+#elif defined(__SSE__)
+		const __m128 g = _mm_setr_ps(gains.left, gains.right, gains.left, gains.right);
+		for (; i + 8 <= samples; i += 8)
+		{
+			const __m128 s0 = _mm_loadu_ps(src + i);
+			const __m128 s1 = _mm_loadu_ps(src + i + 4);
+			_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(s0, g)));
+			_mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_loadu_ps(dst + i + 4), _mm_mul_ps(s1, g)));
+		}
+#endif
+
+		// The vector loops step by an even count, so the pairs stay left/right.
+		for (; i + 2 <= samples; i += 2)
+		{
+			dst[i] += src[i] * gains.left;
+			dst[i + 1] += src[i + 1] * gains.right;
+		}
+		if(i < samples)
+			dst[i] += src[i] * gains.left;
+	}
+
+	void AccumulateStereo(float* dst, unsigned dstChannels, const float* src, std::size_t frames, Gains gains)
+	{
+		if(dstChannels == 2)
+		{
+			Accumulate(dst, src, frames * 2, gains);
+			return;
+		}
+
+		if(dstChannels == 1)
+		{
+			const float gain = gains.left * 0.5f;
+			for (std::size_t i = 0; i < frames; ++i)
+				dst[i] += (src[i * 2] + src[i * 2 + 1]) * gain;
+			return;
+		}
+
+		for (std::size_t i = 0; i < frames; ++i, dst += dstChannels)
+		{
+			dst[0] += src[i * 2] * gains.left;
+			dst[1] += src[i * 2 + 1] * gains.right;
+		}
+	}
+
+	void MasterLimit(float* buf, std::size_t samples, float gain, float threshold)
+	{
+		std::size_t i = 0;
+
+		if(threshold >= 1.0f)
+		{
+			for (; i < samples; ++i)
+				buf[i] *= gain;
+			return;
+		}
+
+		threshold = std::max(threshold, 0.0f);
+		const float invRange = 1.0f / (1.0f - threshold);
+
+#if defined(__AVX__)
+		const __m256 vGain = _mm256_set1_ps(gain);
+		const __m256 vThreshold = _mm256_set1_ps(threshold);
+		const __m256 vInvRange = _mm256_set1_ps(invRange);
+		const __m256 vRange = _mm256_set1_ps(1.0f - threshold);
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 sign = _mm256_set1_ps(-0.0f);
+		for (; i + 8 <= samples; i += 8)
+		{
+			const __m256 x = _mm256_mul_ps(_mm256_loadu_ps(buf + i), vGain);
+			const __m256 a = _mm256_andnot_ps(sign, x);
+			const __m256 e = _mm256_mul_ps(_mm256_max_ps(_mm256_sub_ps(a, vThreshold), _mm256_setzero_ps()), vInvRange);
+			const __m256 y = _mm256_add_ps(_mm256_min_ps(a, vThreshold),
+			                               _mm256_div_ps(_mm256_mul_ps(vRange, e), _mm256_add_ps(one, e)));
+			_mm256_storeu_ps(buf + i, _mm256_or_ps(y, _mm256_and_ps(sign, x)));
+		}
+#elif defined(__SSE__)
+		const __m128 vGain = _mm_set1_ps(gain);
+		const __m128 vThreshold = _mm_set1_ps(threshold);
+		const __m128 vInvRange = _mm_set1_ps(invRange);
+		const __m128 vRange = _mm_set1_ps(1.0f - threshold);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 sign = _mm_set1_ps(-0.0f);
+		for (; i + 4 <= samples; i += 4)
+		{
+			const __m128 x = _mm_mul_ps(_mm_loadu_ps(buf + i), vGain);
+			const __m128 a = _mm_andnot_ps(sign, x);
+			const __m128 e = _mm_mul_ps(_mm_max_ps(_mm_sub_ps(a, vThreshold), _mm_setzero_ps()), vInvRange);
+			const __m128 y = _mm_add_ps(_mm_min_ps(a, vThreshold),
+			                            _mm_div_ps(_mm_mul_ps(vRange, e), _mm_add_ps(one, e)));
+			_mm_storeu_ps(buf + i, _mm_or_ps(y, _mm_and_ps(sign, x)));
+		}
+#endif
+
+		for (; i < samples; ++i)
+			buf[i] = Limit(buf[i] * gain, threshold, invRange);
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+
+namespace Audio
+{
+	// Mixing kernels of the output stream. They don't allocate and don't lock, so they are safe on the audio thread.
+	// The instruction set is picked at compile time (AVX-512, AVX, SSE, scalar fallback), the build targets -march=native.
+	namespace Mixer
+	{
+		struct Gains
+		{
+			float left {1.0f};
+			float right {1.0f};
+		};
+
+		// Equal-power pan law, pan goes from -1 (left) over 0 (centre) to 1 (right).
+		// Scaled so that the centre keeps unity gain and a centred voice sounds as before.
+		Gains Pan(float vol, float pan);
+
+		// dst[i] += src[i] * gain for interleaved stereo samples, the gain alternates between left and right.
+		// Other channel counts work, if both gains are equal.
+		void Accumulate(float* dst, const float* src, std::size_t samples, Gains gains);
+
+		// Mixes interleaved stereo frames into a layout of dstChannels. Mono gets (L + R) / 2 * gains.left,
+		// wider layouts get L and R with their gains on the front pair (the first two channels), the others stay untouched.
+		void AccumulateStereo(float* dst, unsigned dstChannels, const float* src, std::size_t frames, Gains gains);
+
+		// buf[i] = Limit(buf[i] * gain). Samples below threshold pass unchanged,
+		// louder ones bend smoothly towards +-1 instead of clipping. A threshold of 1 or more only applies the gain.
+		void MasterLimit(float* buf, std::size_t samples, float gain, float threshold);
+	}
+}
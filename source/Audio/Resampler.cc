@@ -0,0 +1,195 @@
+#include "Resampler.hh"
+
+#include <array>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+namespace Audio::Resampler
+{
+	namespace
+	{
+		// One filter per range of steps. Steps above 1 lower the cutoff below the output Nyquist frequency, so nothing aliases.
+		constexpr std::array<double, 8> bankSteps {1.0, 1.25, 1.5, 2.0, 2.5, 3.0, 4.0, 8.0};
+		constexpr double cutoff = 0.91;	// Of the lower Nyquist frequency, the Kaiser transition band ends near it.
+		constexpr double beta = 8.0;
+
+		// Coefficients are duplicated for both channels: {c0, c0, c1, c1, ...}, one row of taps * 2 floats per phase.
+		// delta holds the difference to the next phase, so interpolating is one multiply-add.
+		struct Bank
+		{
+			std::vector<float> coeffs;
+			std::vector<float> delta;
+		};
+
+		double BesselI0(double x)
+		{
+			double sum = 1.0, term = 1.0;
+			for (int k = 1; k < 50; ++k)
+			{
+				term *= (x / (2 * k)) * (x / (2 * k));
+				sum += term;
+			}
+			return sum;
+		}
+
+		Bank MakeBank(double step)
+		{
+			constexpr double pi = 3.14159265358979323846;
+			const double fc = cutoff / step;
+			const std::size_t row = taps * 2;
+
+			std::vector<double> rows((phases + 1) * taps);
+			for (unsigned p = 0; p <= phases; ++p)
+			{
+				const double frac = double(p) / phases;
+				double sum = 0.0;
+				for (unsigned k = 0; k < taps; ++k)
+				{
+					const double d = double(k) - (taps / 2 - 1) - frac;
+					const double x = d / (taps / 2);
+					const double window = std::abs(x) < 1.0 ? BesselI0(beta * std::sqrt(1.0 - x * x)) / BesselI0(beta) : 0.0;
+					const double sinc = d == 0.0 ? 1.0 : std::sin(pi * fc * d) / (pi * fc * d);
+					rows[p * taps + k] = fc * sinc * window;
+					sum += rows[p * taps + k];
+				}
+
+				// Unity gain at DC for every phase.
+				for (unsigned k = 0; k < taps; ++k)
+					rows[p * taps + k] /= sum;
+			}
+
+			Bank bank {std::vector<float>(phases * row), std::vector<float>(phases * row)};
+			for (unsigned p = 0; p < phases; ++p)
+			{
+				for (unsigned k = 0; k < taps; ++k)
+				{
+					const float c = float(rows[p * taps + k]);
+					const float d = float(rows[(p + 1) * taps + k] - rows[p * taps + k]);
+					bank.coeffs[p * row + k * 2] = bank.coeffs[p * row + k * 2 + 1] = c;
+					bank.delta[p * row + k * 2] = bank.delta[p * row + k * 2 + 1] = d;
+				}
+			}
+			return bank;
+		}
+
+		const std::array<Bank, bankSteps.size()>& Banks()
+		{
+			static const auto banks = []
+			{
+				std::array<Bank, bankSteps.size()> banks;
+				for (std::size_t i = 0; i < banks.size(); ++i)
+					banks[i] = MakeBank(bankSteps[i]);
+				return banks;
+			}();
+			return banks;
+		}
+
+		const Bank& SelectBank(double step)
+		{
+			std::size_t i = 0;
+			while (i + 1 < bankSteps.size() && bankSteps[i] < step)
+				++i;
+			return Banks()[i];
+		}
+
+		// Output frame = sum of window[j] * (coeffs[j] + w * delta[j]), even floats are left, odd ones right.
+		inline void Dot(const float* window, const float* coeffs, const float* delta, float w, float* output)
+		{
+			std::size_t j = 0;
+
+#if defined(__AVX__)
+			const __m256 vw = _mm256_set1_ps(w);
+			__m256 acc = _mm256_setzero_ps();
+			for (; j + 8 <= taps * 2; j += 8)
+			{
+#if defined(__FMA__)
+				const __m256 c = _mm256_fmadd_ps(vw, _mm256_loadu_ps(delta + j), _mm256_loadu_ps(coeffs + j));
+				acc = _mm256_fmadd_ps(_mm256_loadu_ps(window + j), c, acc);
+#else
+				const __m256 c = _mm256_add_ps(_mm256_loadu_ps(coeffs + j), _mm256_mul_ps(vw, _mm256_loadu_ps(delta + j)));
+				acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(window + j), c));
+#endif
+			}
+			__m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+			sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+			_mm_storel_pi(reinterpret_cast<__m64*>(output), sum);
+#elif defined(__SSE__)
+			const __m128 vw = _mm_set1_ps(w);
+			__m128 acc = _mm_setzero_ps();
+			for (; j + 4 <= taps * 2; j += 4)
+			{
+				const __m128 c = _mm_add_ps(_mm_loadu_ps(coeffs + j), _mm_mul_ps(vw, _mm_loadu_ps(delta + j)));
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(window + j), c));
+			}
+			acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+			_mm_storel_pi(reinterpret_cast<__m64*>(output), acc);
+#else
+			float left = 0.0f, right = 0.0f;
+			for (; j < taps * 2; j += 2)
+			{
+				left += window[j] * (coeffs[j] + w * delta[j]);
+				right += window[j + 1] * (coeffs[j + 1] + w * delta[j + 1]);
+			}
+			output[0] = left;
+			output[1] = right;
+#endif
+		}
+	}
+
+	void Init()
+	{
+		Banks();
+	}
+
+	void Convolve(const float* input, double position, double step, unsigned count, float* output)
+	{
+		const Bank& bank = SelectBank(step);
+		for (unsigned i = 0; i < count; ++i)
+		{
+			const double t = position + i * step;
+			const double index = std::floor(t);
+			const double phase = (t - index) * phases;
+			const unsigned p = std::min(unsigned(phase), phases - 1);
+
+			const float* window = input + (std::size_t(index) - (taps / 2 - 1)) * 2;
+			Dot(window, bank.coeffs.data() + p * taps * 2, bank.delta.data() + p * taps * 2, float(phase - p), output + i * 2);
+		}
+	}
+
+	void Feed(State& state, const float* input, std::size_t frames)
+	{
+		if(frames >= taps)
+		{
+			std::copy_n(input + (frames - taps) * 2, taps * 2, state.history);
+			return;
+		}
+
+		std::copy(state.history + frames * 2, state.history + taps * 2, state.history);
+		std::copy_n(input, frames * 2, state.history + (taps - frames) * 2);
+	}
+
+	std::vector<float> Convert(const float* input, std::size_t frames, unsigned fromRate, unsigned toRate)
+	{
+		const double step = double(fromRate) / toRate;
+		std::vector<float> output(std::size_t(std::ceil(frames / step)) * 2 + 2);
+		std::vector<float> scratch(scratchSamples);
+
+		State state;
+		std::size_t read = 0;
+		const auto outFrames = Process(state, output.data(), unsigned(output.size() / 2), step, scratch.data(),
+			[&](float* dst, std::size_t count)
+			{
+				count = std::min(count, frames - read);
+				std::copy_n(input + read * 2, count * 2, dst);
+				read += count;
+				return count;
+			});
+
+		output.resize(std::size_t(outFrames) * 2);
+		return output;
+	}
+}
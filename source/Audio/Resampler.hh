@@ -0,0 +1,84 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace Audio
+{
+	// Polyphase windowed-sinc resampler for interleaved stereo f32.
+	// Voices play at their source rate times pitch, the resampler turns them into device rate frames.
+	// Pitch only changes the step, so a pitched voice costs the same as any other resampled one.
+	namespace Resampler
+	{
+		constexpr unsigned taps = 32;	// Input frames per output frame.
+		constexpr unsigned phases = 128;	// Filter phases between two input frames, interpolated linearly.
+		constexpr double minStep = 1.0 / 16;
+		constexpr double maxStep = 8.0;	// Input frames per output frame, larger steps are clamped.
+		constexpr unsigned blockFrames = 256;	// Output frames per inner block.
+		// Floats of scratch space Process needs.
+		constexpr std::size_t scratchSamples = (taps * 3 / 2 + 2 + std::size_t(blockFrames * maxStep)) * 2;
+
+		// Per voice. history holds the input frames before the next unread one.
+		struct State
+		{
+			float history[taps * 2] {};
+			double position {taps};	// Of the next output frame, counted from history[0].
+		};
+
+		// Builds the shared filter tables. Call it before an audio thread uses Process (SndOutStream does), later calls return at once.
+		void Init();
+
+		// Computes output frames [0, count) at position + i * step of input, which starts at history[0].
+		void Convolve(const float* input, double position, double step, unsigned count, float* output);
+
+		// Keeps the history up to date while a voice plays at step 1 without resampling, so it can switch seamlessly.
+		void Feed(State& state, const float* input, std::size_t frames);
+
+		// Writes frames output frames, step is input frames per output frame.
+		// fetch(float* dst, std::size_t frames) returns the number of input frames read, fewer only at the end.
+		// Returns fewer frames than asked for only at the end of the input. Doesn't allocate.
+		template<class Fetch>
+		unsigned Process(State& state, float* output, unsigned frames, double step, float* scratch, Fetch&& fetch);
+
+		// Converts a whole buffer (e.g. at load time).
+		std::vector<float> Convert(const float* input, std::size_t frames, unsigned fromRate, unsigned toRate);
+	}
+
+
+	template<class Fetch>
+	unsigned Resampler::Process(State& state, float* output, unsigned frames, double step, float* scratch, Fetch&& fetch)
+	{
+		step = std::clamp(step, minStep, maxStep);
+
+		unsigned done = 0;
+		while (done < frames)
+		{
+			const unsigned count = std::min(frames - done, blockFrames);
+			const double end = state.position + count * step;
+
+			// The window of the last output reaches taps / 2 frames past its centre.
+			const std::size_t needed = std::size_t(end) + taps / 2 + 1;
+			std::copy_n(state.history, taps * 2, scratch);
+			const std::size_t got = fetch(scratch + taps * 2, needed - taps);
+			std::fill(scratch + (taps + got) * 2, scratch + needed * 2, 0.0f);
+
+			// At the end only outputs centred before the last input frame are kept.
+			unsigned valid = count;
+			if(got < needed - taps)
+			{
+				const double last = double(taps + got);
+				valid = state.position < last ? unsigned(std::min<double>(count, std::ceil((last - state.position) / step))) : 0;
+			}
+
+			Convolve(scratch, state.position, step, valid, output + std::size_t(done) * 2);
+			std::copy_n(scratch + (needed - taps) * 2, taps * 2, state.history);
+			state.position = end - double(needed - taps);
+
+			done += valid;
+			if(valid < count)
+				break;
+		}
+		return done;
+	}
+}
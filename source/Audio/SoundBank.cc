@@ -0,0 +1,112 @@
+#include "SoundBank.hh"
+#include "Audio.hh"
+
+namespace Audio
+{
+	const float* SoundClip::Samples() const
+	{
+		return samples.data();
+	}
+
+	std::size_t SoundClip::Frames() const
+	{
+		return channels ? samples.size() / channels : 0;
+	}
+
+	unsigned SoundClip::Channels() const
+	{
+		return channels;
+	}
+
+	unsigned SoundClip::SampleRate() const
+	{
+		return sampleRate;
+	}
+
+	SoundBank::SoundBank(const SndOutStream& stream)
+		: SoundBank(stream.SampleRate(), stream.Channels())
+	{}
+
+	SoundBank::SoundBank(unsigned sampleRate, unsigned channels)
+		: sampleRate(sampleRate), channels(channels)
+	{}
+
+	std::shared_ptr<const SoundClip> SoundBank::Load(const std::string& name, const std::string& filename)
+	{
+		return Decode(name, [&filename](const ma_decoder_config* cfg, ma_decoder* decoder)
+		{
+			return ma_decoder_init_file(filename.c_str(), cfg, decoder);
+		});
+	}
+
+	std::shared_ptr<const SoundClip> SoundBank::Load(const std::string& name, const void* data, std::size_t size)
+	{
+		return Decode(name, [data, size](const ma_decoder_config* cfg, ma_decoder* decoder)
+		{
+			return ma_decoder_init_memory(data, size, cfg, decoder);
+		});
+	}
+
+	std::shared_ptr<const SoundClip> SoundBank::Get(const std::string& name) const
+	{
+		const auto it = clips.find(name);
+		return it != clips.end() ? it->second : nullptr;
+	}
+
+	void SoundBank::Unload(const std::string& name)
+	{
+		clips.erase(name);
+	}
+
+	std::size_t SoundBank::Size() const
+	{
+		return clips.size();
+	}
+
+	std::size_t SoundBank::Memory() const
+	{
+		std::size_t bytes = 0;
+		for (const auto& [name, clip] : clips)
+			bytes += clip->samples.size() * sizeof(float);
+		return bytes;
+	}
+
+	template<class Init>
+	std::shared_ptr<const SoundClip> SoundBank::Decode(const std::string& name, Init init)
+	{
+		// Stereo decodes at the source's rate and goes through the resampler of the stream, which is cleaner than
+		// the one of miniaudio. Other layouts are converted by miniaudio.
+		ma_decoder_config cfg = ma_decoder_config_init(ma_format_f32, channels, channels == 2 ? 0 : sampleRate);
+		ma_decoder decoder {};
+		if(init(&cfg, &decoder) != MA_SUCCESS)
+			return nullptr;
+
+		auto clip = std::make_shared<SoundClip>();
+		clip->channels = channels;
+		clip->sampleRate = sampleRate;
+
+		// The length isn't known for every format up front, so it's read in blocks.
+		const ma_uint64 length = ma_decoder_get_length_in_pcm_frames(&decoder);
+		clip->samples.reserve(std::size_t(length) * channels);
+
+		constexpr ma_uint64 blockFrames = 4096;
+		for (;;)
+		{
+			const std::size_t offset = clip->samples.size();
+			clip->samples.resize(offset + std::size_t(blockFrames) * channels);
+			const ma_uint64 read = ma_decoder_read_pcm_frames(&decoder, clip->samples.data() + offset, blockFrames);
+			clip->samples.resize(offset + std::size_t(read) * channels);
+			if(read < blockFrames)
+				break;
+		}
+		const unsigned sourceRate = decoder.outputSampleRate;
+		ma_decoder_uninit(&decoder);
+
+		if(sourceRate != sampleRate)
+			clip->samples = Resampler::Convert(clip->samples.data(), clip->samples.size() / channels, sourceRate, sampleRate);
+		clip->samples.shrink_to_fit();
+		std::shared_ptr<const SoundClip> result = std::move(clip);
+		clips[name] = result;
+		return result;
+	}
+}
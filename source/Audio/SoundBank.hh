@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Audio
+{
+	class SndOutStream;
+
+	// Immutable f32 PCM, decoded once at the device rate and channel count.
+	// Every play of a clip is a cursor into the same samples, so it may play any number of times at once.
+	class SoundClip
+	{
+		friend class SoundBank;
+
+	public:
+		const float* Samples() const;
+		std::size_t Frames() const;
+		unsigned Channels() const;
+		unsigned SampleRate() const;
+
+	private:
+		std::vector<float> samples;
+		unsigned channels {0};
+		unsigned sampleRate {0};
+	};
+
+
+	// Named clips for short, frequent sounds (footsteps, hits). Long music stays an AudioFile, which decodes while playing.
+	// Loading decodes on the calling thread. A playing clip is kept alive by the stream, even if it's unloaded meanwhile.
+	class SoundBank
+	{
+	public:
+		// Clips are decoded to the format of the stream.
+		explicit SoundBank(const SndOutStream& stream);
+		SoundBank(unsigned sampleRate, unsigned channels);
+
+		// Return nullptr, if the data can't be decoded. Loading a name again replaces the clip.
+		std::shared_ptr<const SoundClip> Load(const std::string& name, const std::string& filename);
+		std::shared_ptr<const SoundClip> Load(const std::string& name, const void* data, std::size_t size);
+
+		// nullptr, if there is no such clip.
+		std::shared_ptr<const SoundClip> Get(const std::string& name) const;
+		void Unload(const std::string& name);
+
+		std::size_t Size() const;
+		// Decoded bytes of all clips.
+		std::size_t Memory() const;
+
+	private:
+		template<class Init>
+		std::shared_ptr<const SoundClip> Decode(const std::string& name, Init init);
+
+		unsigned sampleRate;
+		unsigned channels;
+		std::unordered_map<std::string, std::shared_ptr<const SoundClip>> clips;
+	};
+}
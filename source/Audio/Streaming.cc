@@ -0,0 +1,231 @@
+#include "Streaming.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace Audio
+{
+	namespace
+	{
+		StreamingConfig Checked(StreamingConfig config)
+		{
+			config.decodeFrames = std::max(config.decodeFrames, 1u);
+			return config;
+		}
+	}
+
+	StreamingAudio::StreamingAudio(const std::string& filename, const StreamingConfig& config)
+		: config(Checked(config)), open(OpenFile(filename)), ring(RingSize())
+	{
+		Start();
+	}
+
+	StreamingAudio::StreamingAudio(const void* data, std::size_t size, const StreamingConfig& config)
+		: StreamingAudio(data, size, nullptr, config)
+	{}
+
+	StreamingAudio::StreamingAudio(const void* data, std::size_t size, std::shared_ptr<const void> owner, const StreamingConfig& config)
+		: config(Checked(config)), owner(std::move(owner)), open(OpenMemory(data, size)), ring(RingSize())
+	{
+		Start();
+	}
+
+	StreamingAudio::~StreamingAudio()
+	{
+		if(!open)
+			return;
+
+		StreamDecoder::Global().Remove(*this);
+		ma_decoder_uninit(&decoder);
+	}
+
+	// The decoder keeps the source's rate, the output stream resamples it.
+	bool StreamingAudio::OpenFile(const std::string& filename)
+	{
+		ma_decoder_config cfg = ma_decoder_config_init(ma_format_f32, channels, 0);
+		return ma_decoder_init_file(filename.c_str(), &cfg, &decoder) == MA_SUCCESS;
+	}
+
+	bool StreamingAudio::OpenMemory(const void* data, std::size_t size)
+	{
+		ma_decoder_config cfg = ma_decoder_config_init(ma_format_f32, channels, 0);
+		return ma_decoder_init_memory(data, size, &cfg, &decoder) == MA_SUCCESS;
+	}
+
+	// Refill only pushes whole decoder blocks, so the ring holds at least two of them, whatever bufferMS asks for.
+	std::size_t StreamingAudio::RingSize() const
+	{
+		const std::size_t buffer = std::size_t(open ? SampleRate() : 1) * std::max(config.bufferMS, 1u) / 1000 * channels;
+		return std::max(buffer, std::size_t(config.decodeFrames) * channels * 2);
+	}
+
+	void StreamingAudio::Start()
+	{
+		if(open)
+			StreamDecoder::Global().Add(*this);
+	}
+
+	bool StreamingAudio::IsOpen() const
+	{
+		return open;
+	}
+
+	unsigned long long StreamingAudio::Underruns() const
+	{
+		return underruns.load(std::memory_order_relaxed);
+	}
+
+	unsigned long long StreamingAudio::UnderrunFrames() const
+	{
+		return underrunFrames.load(std::memory_order_relaxed);
+	}
+
+	std::size_t StreamingAudio::Buffered() const
+	{
+		return ring.Size() / channels;
+	}
+
+	unsigned StreamingAudio::Data(void* output, unsigned frameCount)
+	{
+		if(!open)
+			return 0;
+
+		auto out = static_cast<float*>(output);
+		const unsigned gen = seekGen.load(std::memory_order_relaxed);
+		if(flushGen.load(std::memory_order_relaxed) != gen)
+		{
+			// The decoder thread hasn't seeked yet, everything in the ring is from before.
+			if(ackGen.load(std::memory_order_acquire) != gen)
+			{
+				std::memset(out, 0, std::size_t(frameCount) * channels * sizeof(float));
+				return frameCount;
+			}
+
+			ring.Clear();
+			flushGen.store(gen, std::memory_order_release);
+		}
+
+		std::size_t frames = ring.Pop(out, std::size_t(frameCount) * channels) / channels;
+		if(frames < frameCount)
+		{
+			// The end is only certain after the last samples were pushed, they may have arrived since the first pop.
+			if(endGen.load(std::memory_order_acquire) == gen)
+			{
+				frames += ring.Pop(out + frames * channels, (frameCount - frames) * channels) / channels;
+				position += frames;
+				return unsigned(frames);
+			}
+
+			underruns.fetch_add(1, std::memory_order_relaxed);
+			underrunFrames.fetch_add(frameCount - frames, std::memory_order_relaxed);
+			std::memset(out + frames * channels, 0, (frameCount - frames) * channels * sizeof(float));
+		}
+
+		position += frames;
+		return frameCount;
+	}
+
+	void StreamingAudio::SeekFrame(unsigned long long frame)
+	{
+		// Playing from the start right after loading keeps the samples decoded ahead.
+		const unsigned gen = seekGen.load(std::memory_order_relaxed);
+		if(flushGen.load(std::memory_order_relaxed) == gen && frame == position)
+			return;
+
+		position = frame;
+		seekFrame.store(frame, std::memory_order_relaxed);
+		seekGen.store(gen + 1, std::memory_order_release);
+	}
+
+	bool StreamingAudio::Refill(std::vector<float>& scratch)
+	{
+		const unsigned gen = seekGen.load(std::memory_order_acquire);
+		if(ackGen.load(std::memory_order_relaxed) != gen)
+		{
+			ma_decoder_seek_to_pcm_frame(&decoder, seekFrame.load(std::memory_order_relaxed));
+			ended = false;
+			ackGen.store(gen, std::memory_order_release);
+			return true;
+		}
+
+		if(flushGen.load(std::memory_order_acquire) != gen)
+			return true;
+
+		const std::size_t lowWatermark = std::size_t(SampleRate()) * config.lowWatermarkMS / 1000 * channels;
+		if(ended || ring.Size() > lowWatermark)
+			return false;
+
+		const std::size_t blockSize = std::size_t(config.decodeFrames) * channels;
+		while (ring.Size() + blockSize <= ring.Capacity() && seekGen.load(std::memory_order_relaxed) == gen)
+		{
+			const auto frames = ma_decoder_read_pcm_frames(&decoder, scratch.data(), config.decodeFrames);
+			ring.Push(scratch.data(), std::size_t(frames) * channels);
+			if(frames < config.decodeFrames)
+			{
+				ended = true;
+				endGen.store(gen, std::memory_order_release);
+				break;
+			}
+		}
+		return false;
+	}
+
+	StreamDecoder::StreamDecoder()
+		: thread([this] { Loop(); })
+	{}
+
+	StreamDecoder::~StreamDecoder()
+	{
+		{
+			std::lock_guard<std::mutex> lock {mutex};
+			stopping = true;
+		}
+		cvWake.notify_one();
+		thread.join();
+	}
+
+	void StreamDecoder::Add(StreamingAudio& audio)
+	{
+		{
+			std::lock_guard<std::mutex> lock {mutex};
+			streams.push_back(&audio);
+			scratch.resize(std::max<std::size_t>(scratch.size(), std::size_t(audio.config.decodeFrames) * audio.channels));
+		}
+		cvWake.notify_one();
+	}
+
+	void StreamDecoder::Remove(StreamingAudio& audio)
+	{
+		std::lock_guard<std::mutex> lock {mutex};
+		streams.erase(std::remove(streams.begin(), streams.end(), &audio), streams.end());
+	}
+
+	StreamDecoder& StreamDecoder::Global()
+	{
+		static StreamDecoder decoder;
+		return decoder;
+	}
+
+	void StreamDecoder::Loop()
+	{
+		std::unique_lock<std::mutex> lock {mutex};
+		while (!stopping)
+		{
+			if(streams.empty())
+			{
+				cvWake.wait(lock, [this] { return stopping || !streams.empty(); });
+				continue;
+			}
+
+			// A seek waits for the next audio period to drop the old samples, the refill follows soon after.
+			unsigned intervalMS = 20;
+			for (auto* audio : streams)
+			{
+				const bool seeking = audio->Refill(scratch);
+				intervalMS = std::min(intervalMS, seeking ? 1u : std::max(audio->config.lowWatermarkMS / 4, 1u));
+			}
+			cvWake.wait_for(lock, std::chrono::milliseconds(intervalMS));
+		}
+	}
+}
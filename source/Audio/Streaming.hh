@@ -0,0 +1,107 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Audio.hh"
+#include "Misc/Threads/SpscQueue.hh"
+
+
+namespace Audio
+{
+	struct StreamingConfig
+	{
+		unsigned int bufferMS{1000};	// Decoded audio kept ahead of playback.
+		unsigned int lowWatermarkMS{500};	// Below this the decoder thread refills up to bufferMS.
+		unsigned int decodeFrames{4096};	// Frames per decoder call, the ring holds at least two calls.
+	};
+
+
+	// Long tracks (music, ambience). The decoder thread (StreamDecoder) keeps a PCM ring filled ahead of playback,
+	// the audio thread only copies from it. An empty ring before the end plays silence and counts as underrun.
+	// Seeking drops the ring and plays silence, until the decoder thread caught up (a few milliseconds).
+	class StreamingAudio final : public Audio
+	{
+		friend class StreamDecoder;
+
+	public:
+		explicit StreamingAudio(const std::string& filename, const StreamingConfig& config = StreamingConfig{});
+		StreamingAudio(const void* data, std::size_t size, const StreamingConfig& config = StreamingConfig{});
+		// The decoder reads the memory while streaming, owner keeps it alive (e.g. CVFSView::Pin()).
+		StreamingAudio(const void* data, std::size_t size, std::shared_ptr<const void> owner, const StreamingConfig& config = StreamingConfig{});
+		~StreamingAudio() override;
+
+		bool IsOpen() const;
+		// Periods, in which the ring ran dry before the end, and the frames played as silence then.
+		unsigned long long Underruns() const;
+		unsigned long long UnderrunFrames() const;
+		// Decoded frames waiting in the ring.
+		std::size_t Buffered() const;
+
+	private:
+		bool OpenFile(const std::string& filename);
+		bool OpenMemory(const void* data, std::size_t size);
+		std::size_t RingSize() const;
+		void Start();
+
+		// Audio thread
+		unsigned Data(void* output, unsigned frameCount) override;
+		void SeekFrame(unsigned long long frame) override;
+
+		// Decoder thread. Returns true, while a seek waits for the audio thread.
+		bool Refill(std::vector<float>& scratch);
+
+		static constexpr unsigned channels = 2;
+
+		StreamingConfig config;
+		std::shared_ptr<const void> owner;
+		bool open {false};
+		Threads::SpscQueue<float> ring;
+
+		// A seek bumps seekGen. The decoder thread seeks and publishes ackGen, then waits until the
+		// audio thread dropped the old samples and published flushGen, so no stale samples play after a seek.
+		std::atomic<unsigned> seekGen {0};
+		std::atomic<unsigned> ackGen {0};
+		std::atomic<unsigned> flushGen {0};
+		std::atomic<unsigned> endGen {~0u};	// Generation, whose samples are all in the ring.
+		std::atomic<unsigned long long> seekFrame {0};
+		std::atomic<unsigned long long> underruns {0};
+		std::atomic<unsigned long long> underrunFrames {0};
+
+		unsigned long long position {0};	// Audio thread, frame of the next sample.
+		bool ended {false};	// Decoder thread
+	};
+
+
+	// The thread decoding every StreamingAudio. It wakes every lowWatermarkMS / 4 and tops up rings below the watermark.
+	class StreamDecoder
+	{
+	public:
+		StreamDecoder();
+		~StreamDecoder();
+
+		StreamDecoder(const StreamDecoder&) = delete;
+		StreamDecoder& operator=(const StreamDecoder&) = delete;
+
+		void Add(StreamingAudio& audio);
+		// Waits for a running refill of the stream.
+		void Remove(StreamingAudio& audio);
+
+		static StreamDecoder& Global();
+
+	private:
+		void Loop();
+
+		std::vector<StreamingAudio*> streams;
+		std::vector<float> scratch;
+		std::mutex mutex;
+		std::condition_variable cvWake;
+		bool stopping {false};
+		std::thread thread;
+	};
+}
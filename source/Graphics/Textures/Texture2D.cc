@@ -7,6 +7,20 @@
 namespace Graphics
 {
 	Texture2D::Texture2D(std::string& path)
+	{
+		stbi_set_flip_vertically_on_load(false);
+		data = stbi_load(path.c_str(), &width, &height, &channels, 0);
+		Upload();
+	}
+
+	Texture2D::Texture2D(const void* encoded, std::size_t size)
+	{
+		stbi_set_flip_vertically_on_load(false);
+		data = stbi_load_from_memory(static_cast<const stbi_uc*>(encoded), static_cast<int>(size), &width, &height, &channels, 0);
+		Upload();
+	}
+
+	void Texture2D::Upload()
 	{
 		glGenTextures(1, &texture);
 		glBindTexture(GL_TEXTURE_2D, texture);
@@ -16,8 +30,6 @@ namespace Graphics
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
 
-		stbi_set_flip_vertically_on_load(false);
-		data = stbi_load(path.c_str(), &width, &height, &channels, 0);
 		if (data)
 		{
 			if(channels == 3)
@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <cstddef>
 
 namespace Graphics
 {
@@ -7,11 +8,14 @@ namespace Graphics
 	{
 	public:
 		Texture2D(std::string& path);
+		Texture2D(const void* encoded, std::size_t size);	// Decodes an image file from memory, e.g. a VFS view.
 		Texture2D(int pixels[], int width, int height);
 		void Bind();
 		void Unbind();
 
 	private:
+		void Upload();
+
 		int width, height, channels;
 		unsigned char* data;
 		unsigned int texture;
@@ -31,19 +31,20 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 	}
 }
 
-void PrintDirs(Assets::CVFS &vfs, const std::string &Path, const std::string &Shift = "")
+void PrintDirs(Assets::CVFS &vfs, const std::string &Path)
 {
-	auto node = vfs.GetNodeInfo(Path);
-	auto childs = vfs.List(node);
-
-	std::cout << Shift << "Dir: " << node->Name() << std::endl;
-	for (auto &&i : childs)
+	std::cout << "Dir: " << vfs.GetNodeInfo(Path)->Name() << std::endl;
+	vfs.Walk(Path, [](std::span<const Assets::SVFSEntry> Entries)
 	{
-		if(i->IsDir())
-			PrintDirs(vfs, Path + i->Name() + "/", Shift + " ");
-		else
-			std::cout << Shift << " File: " << i->Name() << " Size: " << vfs.FileSize(i) << std::endl;
-	}
+		for (auto &&i : Entries)
+		{
+			std::string Shift(i.Depth, ' ');
+			if(i.IsDir)
+				std::cout << Shift << "Dir: " << i.Name() << std::endl;
+			else
+				std::cout << Shift << "File: " << i.Name() << " Size: " << i.Size << std::endl;
+		}
+	});
 }
 
 int main(void)
@@ -121,6 +122,7 @@ int main(void)
 
 		glfwSwapBuffers(window);
 		glfwPollEvents();
+		snd.Update();
 
 		std::this_thread::sleep_for(std::chrono::milliseconds(1000 / FPS));
 	}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace Threads
+{
+	// Bounded queue for exactly one producer and one consumer thread.
+	// Push and Pop are wait-free: no locks, no allocation, no syscalls, so the consumer may be a realtime thread.
+	template<class T>
+	class SpscQueue
+	{
+	public:
+		// The capacity is rounded up to a power of two.
+		explicit SpscQueue(std::size_t capacity)
+		{
+			std::size_t size = 2;
+			while (size < capacity)
+				size *= 2;
+
+			slots = std::make_unique<T[]>(size);
+			mask = size - 1;
+		}
+
+		SpscQueue(const SpscQueue&) = delete;
+		SpscQueue& operator=(const SpscQueue&) = delete;
+
+		// Producer only. Returns false, if the queue is full.
+		bool Push(T value)
+		{
+			const std::size_t tail = this->tail.load(std::memory_order_relaxed);
+			if (tail - headCache > mask)
+			{
+				headCache = head.load(std::memory_order_acquire);
+				if (tail - headCache > mask)
+					return false;
+			}
+
+			slots[tail & mask] = std::move(value);
+			this->tail.store(tail + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer only. Returns false, if the queue is empty.
+		bool Pop(T& value)
+		{
+			const std::size_t head = this->head.load(std::memory_order_relaxed);
+			if (head == tailCache)
+			{
+				tailCache = tail.load(std::memory_order_acquire);
+				if (head == tailCache)
+					return false;
+			}
+
+			value = std::move(slots[head & mask]);
+			this->head.store(head + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Producer only. Pushes as many values as fit and returns their number.
+		std::size_t Push(const T* values, std::size_t count)
+		{
+			const std::size_t tail = this->tail.load(std::memory_order_relaxed);
+			if (tail - headCache + count > mask + 1)
+				headCache = head.load(std::memory_order_acquire);
+
+			count = std::min(count, mask + 1 - (tail - headCache));
+			const std::size_t first = std::min(count, mask + 1 - (tail & mask));
+			std::copy_n(values, first, slots.get() + (tail & mask));
+			std::copy_n(values + first, count - first, slots.get());
+			this->tail.store(tail + count, std::memory_order_release);
+			return count;
+		}
+
+		// Consumer only. Pops up to count values and returns their number.
+		std::size_t Pop(T* values, std::size_t count)
+		{
+			const std::size_t head = this->head.load(std::memory_order_relaxed);
+			if (tailCache - head < count)
+				tailCache = tail.load(std::memory_order_acquire);
+
+			count = std::min(count, tailCache - head);
+			const std::size_t first = std::min(count, mask + 1 - (head & mask));
+			std::move(slots.get() + (head & mask), slots.get() + (head & mask) + first, values);
+			std::move(slots.get(), slots.get() + (count - first), values + first);
+			this->head.store(head + count, std::memory_order_release);
+			return count;
+		}
+
+		// Consumer only. Drops everything pushed so far.
+		void Clear()
+		{
+			tailCache = tail.load(std::memory_order_acquire);
+			head.store(tailCache, std::memory_order_release);
+		}
+
+		// Either side. A snapshot, the other side may change it right after.
+		std::size_t Size() const
+		{
+			const std::size_t head = this->head.load(std::memory_order_acquire);
+			return tail.load(std::memory_order_acquire) - head;
+		}
+
+		std::size_t Capacity() const
+		{
+			return mask + 1;
+		}
+
+	private:
+		// Each side keeps its index and its cached copy of the other index on its own cache line.
+		static constexpr std::size_t cacheLine = 64;
+
+		std::unique_ptr<T[]> slots;
+		std::size_t mask;
+
+		alignas(cacheLine) std::atomic<std::size_t> head {0};
+		std::size_t tailCache {0};
+
+		alignas(cacheLine) std::atomic<std::size_t> tail {0};
+		std::size_t headCache {0};
+	};
+}
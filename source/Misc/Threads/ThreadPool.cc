@@ -0,0 +1,63 @@
+#include "ThreadPool.hh"
+
+namespace Threads
+{
+	ThreadPool::ThreadPool(std::size_t threads)
+	{
+		threads = std::max<std::size_t>(threads, 1);
+		workers.reserve(threads);
+		for (std::size_t i = 0; i < threads; ++i)
+			workers.emplace_back([this] { WorkerLoop(); });
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock {mutex};
+			stopping = true;
+		}
+		cvTask.notify_all();
+
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	void ThreadPool::Submit(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock {mutex};
+			tasks.push(std::move(task));
+		}
+		cvTask.notify_one();
+	}
+
+	std::size_t ThreadPool::Size() const
+	{
+		return workers.size();
+	}
+
+	ThreadPool& ThreadPool::Global()
+	{
+		static ThreadPool pool;
+		return pool;
+	}
+
+	void ThreadPool::WorkerLoop()
+	{
+		for (;;)
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock {mutex};
+				cvTask.wait(lock, [this] { return stopping || !tasks.empty(); });
+				if (stopping && tasks.empty())
+					return;
+
+				task = std::move(tasks.front());
+				tasks.pop();
+			}
+
+			task();
+		}
+	}
+}
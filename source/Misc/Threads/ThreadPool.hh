@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace Threads
+{
+	class ThreadPool
+	{
+	public:
+		explicit ThreadPool(std::size_t threads = std::thread::hardware_concurrency());
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		void Submit(std::function<void()> task);
+		std::size_t Size() const;
+
+		// Calls func(i) for every i in [0, count) and returns once all calls are done.
+		// The calling thread takes part in the work, so it's safe to nest from inside a task.
+		// maxThreads limits the number of threads (0 = all), the first exception is rethrown.
+		template<class F>
+		void ParallelFor(std::size_t count, F func, std::size_t maxThreads = 0);
+
+		static ThreadPool& Global();
+
+	private:
+		void WorkerLoop();
+
+		std::vector<std::thread> workers;
+		std::queue<std::function<void()>> tasks;
+		std::mutex mutex;
+		std::condition_variable cvTask;
+		bool stopping {false};
+	};
+
+	template<class F>
+	void ThreadPool::ParallelFor(std::size_t count, F func, std::size_t maxThreads)
+	{
+		struct State
+		{
+			std::atomic<std::size_t> next {0};
+			std::mutex mutex;
+			std::condition_variable cvDone;
+			std::size_t active {0};
+			std::exception_ptr error;
+		};
+
+		auto state = std::make_shared<State>();
+		auto run = [state, count, &func]()
+		{
+			for (std::size_t i; (i = state->next++) < count;)
+			{
+				try
+				{
+					func(i);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock {state->mutex};
+					if (!state->error)
+						state->error = std::current_exception();
+					state->next = count;
+				}
+			}
+		};
+
+		std::size_t helpers = std::min(workers.size(), count ? count - 1 : 0);
+		if (maxThreads != 0)
+			helpers = std::min(helpers, maxThreads - 1);
+
+		for (std::size_t i = 0; i < helpers; ++i)
+		{
+			Submit([state, count, run]()
+			{
+				{
+					// Helpers, which start after the work ran out, must not touch func anymore.
+					std::lock_guard<std::mutex> lock {state->mutex};
+					if (state->next >= count)
+						return;
+					++state->active;
+				}
+
+				run();
+
+				std::lock_guard<std::mutex> lock {state->mutex};
+				if (--state->active == 0)
+					state->cvDone.notify_all();
+			});
+		}
+
+		run();
+
+		std::unique_lock<std::mutex> lock {state->mutex};
+		state->cvDone.wait(lock, [&state] { return state->active == 0; });
+		if (state->error)
+			std::rethrow_exception(state->error);
+	}
+}